@@ -462,11 +462,11 @@ struct ProfileEntry
 	std::uint32_t seconds;
 	std::uint32_t microseconds;
 
-	unsigned long long as_microseconds()
+	unsigned long long as_microseconds() const
 	{
 		return 1000000 * (unsigned long long)seconds + microseconds;
 	}
-	double as_seconds()
+	double as_seconds() const
 	{
 		return (double)seconds + ((double)microseconds / 1000000);
 	}
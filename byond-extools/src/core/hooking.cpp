@@ -1,5 +1,7 @@
 #include "hooking.h"
 #include "../tffi/tffi.h"
+#include "../profiler/latency.h"
+#include "../profiler/arg_types.h"
 #include <chrono>
 #include <fstream>
 #include "../third_party/json.hpp"
@@ -10,6 +12,7 @@ CrashProcPtr oCrashProc;
 CallGlobalProcPtr oCallGlobalProc;
 TopicFloodCheckPtr oTopicFloodCheck;
 StartTimingPtr oStartTiming;
+SendMapsPtr oSendMaps;
 
 TopicFilter current_topic_filter = nullptr;
 
@@ -20,6 +23,10 @@ std::unordered_map<void*, std::unique_ptr<subhook::Hook>> hooks;
 std::vector<QueuedCall> queued_calls;
 bool calling_queue = false;
 
+std::mutex tick_jobs_mutex;
+std::vector<std::function<void()>> tick_jobs;
+std::vector<std::function<void(std::chrono::nanoseconds)>> maptick_listeners;
+
 trvh REGPARM3 hCallGlobalProc(char usr_type, int usr_value, int proc_type, unsigned int proc_id, int const_0, DataType src_type, int src_value, Value *argList, unsigned char argListLen, int const_0_2, int const_0_3)
 {
 	//if(proc_id < Core::codecov_executed_procs.size())
@@ -43,6 +50,21 @@ trvh REGPARM3 hCallGlobalProc(char usr_type, int usr_value, int proc_type, unsig
 		calling_queue = false;
 	}*/
 	Core::extended_profiling_insanely_hacky_check_if_its_a_new_call_or_resume = proc_id;
+	// Only decide whether to time the call here. The proc can turn tracking off and free its tracker,
+	// so the tracker is looked up again once the call returns.
+	bool timed = Profiler::latency_tracking_enabled && Profiler::proc_latency(proc_id);
+	std::chrono::steady_clock::time_point start;
+	if (timed)
+	{
+		start = std::chrono::steady_clock::now();
+	}
+	if (Profiler::arg_profiling_enabled)
+	{
+		if (Profiler::ArgTypeProfile* profile = Profiler::arg_profile(proc_id))
+		{
+			profile->record(src_type, argList, argListLen);
+		}
+	}
 	if (auto ptr = proc_hooks.find((unsigned short)proc_id); ptr != proc_hooks.end())
 	{
 		trvh result = ptr->second(argListLen, argList, src_type ? Value(src_type, src_value) : static_cast<Value>(Value::Null()));
@@ -50,9 +72,17 @@ trvh REGPARM3 hCallGlobalProc(char usr_type, int usr_value, int proc_type, unsig
 		{
 			DecRefCount(argList[i].type, argList[i].value);
 		}
+		if (Profiler::LatencyTracker* latency = timed ? Profiler::proc_latency(proc_id) : nullptr)
+		{
+			latency->record(start, std::chrono::steady_clock::now());
+		}
 		return result;
 	}
 	trvh result = oCallGlobalProc(usr_type, usr_value, proc_type, proc_id, const_0, src_type, src_value, argList, argListLen, const_0_2, const_0_3);
+	if (Profiler::LatencyTracker* latency = timed ? Profiler::proc_latency(proc_id) : nullptr)
+	{
+		latency->record(start, std::chrono::steady_clock::now()); // sleeping procs are only timed up to their first sleep
+	}
 	Core::extended_profiling_insanely_hacky_check_if_its_a_new_call_or_resume = -1;
 	return result;
 }
@@ -62,6 +92,17 @@ void hCrashProc(char *error, variadic_arg_hack hack) //this is a hack to pass va
 	int argument = *(int*)hack.data;
 	if (auto ptr = Core::opcode_handlers.find(argument); ptr != Core::opcode_handlers.end())
 	{
+		if (Profiler::latency_tracking_enabled && Profiler::opcode_latency(argument))
+		{
+			auto start = std::chrono::steady_clock::now();
+			ptr->second(*Core::current_execution_context_ptr);
+			// The handler may have stopped tracking this opcode, so don't hold on to the tracker across it.
+			if (Profiler::LatencyTracker* latency = Profiler::opcode_latency(argument))
+			{
+				latency->record(start, std::chrono::steady_clock::now());
+			}
+			return;
+		}
 		ptr->second(*Core::current_execution_context_ptr);
 		return;
 	}
@@ -88,6 +129,33 @@ void hStartTiming(SuspendedProc* sp)
 	oStartTiming(sp);
 }
 
+void hSendMaps()
+{
+	if (maptick_listeners.empty())
+	{
+		oSendMaps();
+	}
+	else
+	{
+		auto start = std::chrono::steady_clock::now();
+		oSendMaps();
+		auto duration = std::chrono::steady_clock::now() - start;
+		for (auto& listener : maptick_listeners)
+		{
+			listener(duration);
+		}
+	}
+	std::vector<std::function<void()>> jobs;
+	{
+		std::lock_guard<std::mutex> lk(tick_jobs_mutex);
+		jobs.swap(tick_jobs);
+	}
+	for (auto& job : jobs)
+	{
+		job();
+	}
+}
+
 void Core::set_topic_filter(TopicFilter tf)
 {
 	current_topic_filter = tf;
@@ -103,6 +171,11 @@ void* Core::untyped_install_hook(void* original, void* hook)
 	return trampoline;
 }
 
+bool Core::is_hooked(void* original)
+{
+	return hooks.find(original) != hooks.end();
+}
+
 void Core::remove_hook(void* func)
 {
 	hooks[func]->Remove();
@@ -116,6 +189,10 @@ void Core::remove_all_hooks()
 		iter->second->Remove();
 		iter = hooks.erase(iter);
 	}
+	oSendMaps = nullptr;
+	maptick_listeners.clear();
+	std::lock_guard<std::mutex> lk(tick_jobs_mutex);
+	tick_jobs.clear();
 }
 
 bool Core::hook_custom_opcodes() {
@@ -129,3 +206,28 @@ bool Core::hook_custom_opcodes() {
 	}
 	return true;
 }
+
+bool Core::hook_ticks()
+{
+	if (!oSendMaps)
+	{
+		oSendMaps = install_hook(SendMaps, hSendMaps);
+	}
+	return oSendMaps;
+}
+
+void Core::run_between_ticks(std::function<void()> job)
+{
+	std::lock_guard<std::mutex> lk(tick_jobs_mutex);
+	tick_jobs.push_back(std::move(job));
+}
+
+bool Core::on_maptick(std::function<void(std::chrono::nanoseconds)> listener)
+{
+	if (!hook_ticks())
+	{
+		return false;
+	}
+	maptick_listeners.push_back(std::move(listener));
+	return true;
+}
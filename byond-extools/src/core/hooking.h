@@ -10,6 +10,9 @@
 #include "../third_party/subhook/subhook.h"
 //#endif
 
+#include <chrono>
+#include <functional>
+
 typedef bool(*TopicFilter)(BSocket* socket, int socket_id);
 extern TopicFilter current_topic_filter;
 
@@ -37,9 +40,19 @@ namespace Core
 		return (FnPtr) untyped_install_hook((void*) original, (void*) hook);
 	}
 
+	// Hooking a function twice doesn't chain the hooks, so modules sharing one have to check first.
+	bool is_hooked(void* original);
 	void remove_hook(void* func);
 	void remove_all_hooks();
 	bool hook_custom_opcodes();
 	void set_topic_filter(TopicFilter tf);
+
+	// Hooks SendMaps, which runs once per tick after all procs are done. Install it from the main thread.
+	bool hook_ticks();
+	// Runs `job` on the main thread right after the next map update, which is between two ticks and while no
+	// proc is executing. Safe to call from any thread once hook_ticks() succeeded.
+	void run_between_ticks(std::function<void()> job);
+	// Calls `listener` after every map update with the time SendMaps took. Also installs the hook.
+	bool on_maptick(std::function<void(std::chrono::nanoseconds)> listener);
 	//void schedule_call(Proc proc, std::vector<Value> args, Value src = Value::Null(), Value usr = Value::Null());
 }
\ No newline at end of file
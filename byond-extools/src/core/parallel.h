@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace Core
+{
+	// Calls fn(i) for every i in [0, count) on a handful of worker threads and returns once all of them are done.
+	// Work is handed out in small batches, so a few huge procs don't leave the other threads idle.
+	// Only meant for read-only passes over BYOND data while the game thread waits on this call: fn must not
+	// call into BYOND functions that allocate or touch refcounts.
+	template<typename Fn>
+	void parallel_for(std::size_t count, Fn fn, std::size_t batch = 64)
+	{
+		std::size_t workers = std::min<std::size_t>(std::max(1u, std::thread::hardware_concurrency()), (count + batch - 1) / batch);
+		if (workers <= 1)
+		{
+			for (std::size_t i = 0; i < count; i++)
+			{
+				fn(i);
+			}
+			return;
+		}
+		std::atomic<std::size_t> next = 0;
+		auto work = [&]() {
+			for (std::size_t start = next.fetch_add(batch); start < count; start = next.fetch_add(batch))
+			{
+				std::size_t end = std::min(start + batch, count);
+				for (std::size_t i = start; i < end; i++)
+				{
+					fn(i);
+				}
+			}
+		};
+		std::vector<std::thread> threads;
+		threads.reserve(workers - 1);
+		for (std::size_t i = 1; i < workers; i++)
+		{
+			threads.emplace_back(work);
+		}
+		work();
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+}
@@ -20,16 +20,43 @@ void strip_proc_path(std::string& name)
 	}
 }
 
+// Sleeping procs and procs further up the call stack keep executing whatever buffer they started in, and we can't
+// see all of them, so replaced buffers are kept around for good. Bytecode is small and this only grows when a proc
+// is patched.
+static std::vector<std::vector<std::uint32_t>> retired_bytecode;
+
 void Core::Proc::set_bytecode(std::vector<std::uint32_t>&& new_bytecode)
 {
 	if (!original_bytecode_ptr)
 	{
 		original_bytecode_ptr = *bytecode_entry.ppBytecode;
+		original_bytecode_length = bytecode_entry.length;
+	}
+	else if (!bytecode.empty())
+	{
+		retired_bytecode.push_back(std::move(bytecode));
 	}
-
 
 	bytecode = std::move(new_bytecode);
 	*bytecode_entry.ppBytecode = bytecode.data();
+	bytecode_entry.length = bytecode.size();
+}
+
+void Core::Proc::use_bytecode(std::uint32_t* code, std::uint16_t length)
+{
+	if (!original_bytecode_ptr)
+	{
+		original_bytecode_ptr = *bytecode_entry.ppBytecode;
+		original_bytecode_length = bytecode_entry.length;
+	}
+	else if (!bytecode.empty())
+	{
+		retired_bytecode.push_back(std::move(bytecode));
+		bytecode.clear();
+	}
+
+	*bytecode_entry.ppBytecode = code;
+	bytecode_entry.length = length;
 }
 
 void Core::Proc::reset_bytecode()
@@ -37,8 +64,13 @@ void Core::Proc::reset_bytecode()
 	if (original_bytecode_ptr)
 	{
 		*(bytecode_entry.ppBytecode) = original_bytecode_ptr;
+		bytecode_entry.length = original_bytecode_length;
 		original_bytecode_ptr = nullptr;
-		bytecode.clear();
+		if (!bytecode.empty())
+		{
+			retired_bytecode.push_back(std::move(bytecode));
+			bytecode.clear();
+		}
 	}
 }
 
@@ -38,9 +38,14 @@ namespace Core
 		std::uint32_t varcount_idx = 0;
 
 		std::uint32_t* original_bytecode_ptr = nullptr;
+		std::uint16_t original_bytecode_length = 0;
 		std::vector<std::uint32_t> bytecode;
 
+		// The buffer being replaced is never freed, frames that are running or sleeping in it keep using it.
 		void set_bytecode(std::vector<std::uint32_t>&& new_bytecode);
+		// Like set_bytecode, but points the proc at a buffer the caller owns and keeps alive for good. Nothing is
+		// copied, so switching back and forth between such buffers doesn't use more memory each time.
+		void use_bytecode(std::uint32_t* code, std::uint16_t length);
 		std::uint32_t* get_bytecode();
 		std::uint16_t get_bytecode_length();
 		void reset_bytecode();
@@ -214,48 +214,157 @@ bool JsonStream::connect(const char* port, const char* remote)
 	return connect_socket(socket, port, remote, true);
 }
 
+bool framing_from_string(const std::string& name, Framing& out)
+{
+	if (name == "json")
+	{
+		out = Framing::JSON;
+	}
+	else if (name == "msgpack")
+	{
+		out = Framing::MSGPACK;
+	}
+	else if (name == "cbor")
+	{
+		out = Framing::CBOR;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+const char* framing_name(Framing framing)
+{
+	switch (framing)
+	{
+	case Framing::MSGPACK:
+		return "msgpack";
+	case Framing::CBOR:
+		return "cbor";
+	default:
+		return "json";
+	}
+}
+
+// Anything bigger is a corrupt stream rather than a real message.
+static const std::uint32_t MAX_FRAME_SIZE = 256 * 1024 * 1024;
+
 bool JsonStream::send(const char* type, nlohmann::json content)
 {
 	nlohmann::json j = {
 		{"type", type},
-		{"content", content},
+		{"content", std::move(content)},
 	};
 	return send(j);
 }
 
-bool JsonStream::send(nlohmann::json j)
+bool JsonStream::send(const nlohmann::json& j, Framing with)
 {
-	std::string data = j.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
-	data.push_back(0);
-	while (!data.empty())
+	std::string data;
+	if (with == Framing::JSON)
 	{
-		int sent_bytes = ::send(socket.raw(), data.data(), data.size(), 0);
+		data = j.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+		data.push_back(0);
+		return send_all(data.data(), data.size());
+	}
+
+	data.assign(4, 0); // length, filled in below
+	if (with == Framing::MSGPACK)
+	{
+		nlohmann::json::to_msgpack(j, data);
+	}
+	else
+	{
+		nlohmann::json::to_cbor(j, data);
+	}
+	std::uint32_t length = data.size() - 4;
+	for (int i = 0; i < 4; i++)
+	{
+		data[i] = (char)(length >> (24 - i * 8));
+	}
+	return send_all(data.data(), data.size());
+}
+
+bool JsonStream::send_all(const char* data, std::size_t size)
+{
+	std::lock_guard<std::mutex> lk(*send_mutex);
+	while (size)
+	{
+		int sent_bytes = ::send(socket.raw(), data, size, 0);
 		if (sent_bytes == SOCKET_ERROR)
 		{
 			return false;
 		}
-		data.erase(data.begin(), data.begin() + sent_bytes);
+		data += sent_bytes;
+		size -= sent_bytes;
 	}
 	return true;
 }
 
+bool JsonStream::recv_more()
+{
+	// Drop parsed messages only once they're most of the buffer, so a burst of small ones isn't quadratic.
+	if (recv_start > 0 && recv_start * 2 >= recv_buffer.size())
+	{
+		recv_buffer.erase(0, recv_start);
+		recv_scanned -= recv_start;
+		recv_start = 0;
+	}
+
+	char data[4096];
+	int received_bytes = ::recv(socket.raw(), data, sizeof(data), 0);
+	if (received_bytes <= 0)
+	{
+		return false;
+	}
+	recv_buffer.append(data, received_bytes);
+	return true;
+}
+
 nlohmann::json JsonStream::recv_message()
 {
-	std::vector<char> data(1024);
 	while (true)
 	{
-		if (size_t zero = recv_buffer.find('\0'); zero != std::string::npos) {
-			nlohmann::json json = nlohmann::json::parse({ recv_buffer.data(), recv_buffer.data() + zero });
-			recv_buffer.erase(0, zero + 1);
-			return json;
+		const char* begin = recv_buffer.data() + recv_start;
+		if (framing == Framing::JSON)
+		{
+			if (size_t zero = recv_buffer.find('\0', recv_scanned); zero != std::string::npos)
+			{
+				const char* end = recv_buffer.data() + zero;
+				recv_start = recv_scanned = zero + 1;
+				return nlohmann::json::parse(begin, end);
+			}
+			recv_scanned = recv_buffer.size();
+		}
+		else if (recv_buffer.size() - recv_start >= 4)
+		{
+			std::uint32_t length = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				length = length << 8 | (unsigned char)begin[i];
+			}
+			if (length > MAX_FRAME_SIZE)
+			{
+				return nlohmann::json();
+			}
+			if (recv_buffer.size() - recv_start - 4 >= length)
+			{
+				const char* payload = begin + 4;
+				recv_start = recv_scanned = recv_start + 4 + length;
+				if (framing == Framing::MSGPACK)
+				{
+					return nlohmann::json::from_msgpack(payload, payload + length);
+				}
+				return nlohmann::json::from_cbor(payload, payload + length);
+			}
 		}
 
-		int received_bytes = ::recv(socket.raw(), data.data(), data.size(), 0);
-		if (received_bytes == 0) {
+		if (!recv_more())
+		{
 			return nlohmann::json();
 		}
-
-		recv_buffer.append(data.begin(), data.begin() + received_bytes);
 	}
 }
 
@@ -2,6 +2,8 @@
 
 #include "../core.h"
 #include "../../third_party/json.hpp"
+#include <memory>
+#include <mutex>
 #include <string>
 
 #ifdef _WIN32
@@ -44,10 +46,28 @@ public:
 	SOCKET raw() { return raw_socket; }
 };
 
+enum class Framing
+{
+	JSON, // NUL-terminated JSON text
+	MSGPACK, // 4-byte big-endian length, then MessagePack
+	CBOR, // 4-byte big-endian length, then CBOR
+};
+
+bool framing_from_string(const std::string& name, Framing& out);
+const char* framing_name(Framing framing);
+
 class JsonStream
 {
 	Socket socket;
+	Framing framing = Framing::JSON;
 	std::string recv_buffer;
+	std::size_t recv_start = 0; // bytes before this were already parsed
+	std::size_t recv_scanned = 0; // no NUL before this, in JSON framing
+	// Messages can be sent from more than one thread, and must not interleave.
+	std::unique_ptr<std::mutex> send_mutex = std::make_unique<std::mutex>();
+
+	bool send_all(const char* data, std::size_t size);
+	bool recv_more();
 public:
 	JsonStream() {}
 	explicit JsonStream(Socket&& socket) : socket(std::move(socket)) {}
@@ -55,9 +75,15 @@ public:
 	bool connect(const char* port = DBG_DEFAULT_PORT, const char* remote = "127.0.0.1");
 
 	bool send(const char* type, nlohmann::json content);
-	bool send(nlohmann::json j);
+	bool send(const nlohmann::json& j) { return send(j, framing); }
+	bool send(const nlohmann::json& j, Framing with);
 	nlohmann::json recv_message();
+	// Both ends have to switch at the same point in the stream; see "framing" in protocol.ts. Not synchronized,
+	// so call it from the thread that receives, and have other senders pass their framing to send().
+	void set_framing(Framing new_framing) { framing = new_framing; recv_scanned = recv_start; }
+	Framing get_framing() const { return framing; }
 	void close() { socket.close(); }
+	bool valid() { return socket.raw() != INVALID_SOCKET; }
 };
 
 class JsonListener
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace Core
+{
+	// A fixed-size queue between exactly one producer thread and one consumer thread, with no locks. Slots are
+	// written and read in place, so pushing never allocates and a full ring just refuses the item.
+	template<typename T, std::size_t N>
+	class SpscRing
+	{
+		static_assert(N && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+	public:
+		// Producer: the slot to fill in, or null if the ring is full. Nothing is visible until commit().
+		T* claim()
+		{
+			std::size_t h = head.load(std::memory_order_relaxed);
+			if (h - tail.load(std::memory_order_acquire) == N)
+			{
+				return nullptr;
+			}
+			return &slots[h & (N - 1)];
+		}
+
+		void commit()
+		{
+			head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		// Consumer: the oldest item, or null if the ring is empty. It stays valid until pop().
+		const T* front()
+		{
+			std::size_t t = tail.load(std::memory_order_relaxed);
+			if (t == head.load(std::memory_order_acquire))
+			{
+				return nullptr;
+			}
+			return &slots[t & (N - 1)];
+		}
+
+		void pop()
+		{
+			tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+	private:
+		std::array<T, N> slots;
+		// Apart, so the two threads don't bounce one cache line between them.
+		alignas(64) std::atomic<std::size_t> head = 0; // next slot to write
+		alignas(64) std::atomic<std::size_t> tail = 0; // next slot to read
+	};
+}
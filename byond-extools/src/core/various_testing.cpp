@@ -41,32 +41,6 @@ trvh show_profiles(Value* args, unsigned int argcount)
 	return Value::Null();
 }
 
-void cheap_hypotenuse_opcode(ExecutionContext* ctx) //for testing purposes, remove later
-{
-	//Core::Alert("Calculating hypotenuse");
-	const float Ax = Core::get_stack_value(4).valuef;
-	const float Ay = Core::get_stack_value(3).valuef;
-	const float Bx = Core::get_stack_value(2).valuef;
-	const float By = Core::get_stack_value(1).valuef;
-	Core::stack_pop(4);
-	Core::stack_push({ DataType::NUMBER, (int)std::sqrt((Ax - Bx) * (Ax - Bx) + (Ay - By) * (Ay - By)) });
-}
-
-
-
-unsigned char _number_op_localm_localn_store_localx[] =
-{
-	0x55,							// PUSH EBP
-	0x8B, 0xEC,						// MOV EBP, ESP
-	0x8B, 0x45, 0x08,				// MOV EAX, DWORD PTR SS : [EBP + 0x8]
-	0x8B, 0x40, 0x38,				// MOV EAX, DWORD PTR DS : [EAX + 0x38]
-	0xF3, 0x0F, 0x10, 0x40, 0x0C,	// MOVSS XMM0, DWORD PTR DS : [EAX + 0xC]
-	0xF3, 0x0F, 0x58, 0x40, 0x04,	// ADDSS XMM0, DWORD PTR DS : [EAX + 0x4]
-	0xF3, 0x0F, 0x11, 0x40, 0x14,	// MOVSS DWORD PTR DS : [EAX + 0x14], XMM0
-	0x5D,							// POP EBP
-	0xC3,							// RET
-};
-
 template<typename T>
 class ext_vector : std::vector<T>
 {
@@ -78,25 +52,6 @@ public:
 	}
 };
 
-#ifdef _WIN32
-opcode_handler _generate_number_op_localm_localn_store_localx(unsigned char op, int localm, int localn, int localx)
-{
-	unsigned char* func = (unsigned char*)VirtualAlloc(NULL, 64, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
-	if (!func)
-	{
-		return nullptr;
-	}
-	std::memcpy(func, _number_op_localm_localn_store_localx, 26);
-	func[16] = op;
-	func[13] = 4 + 8 * localm;
-	func[18] = 4 + 8 * localn;
-	func[23] = 4 + 8 * localx;
-	DWORD old_prot;
-	VirtualProtect(func, 64, PAGE_EXECUTE_READ, &old_prot);
-	return (opcode_handler)func;
-}
-#endif
-
 extern "C" EXPORT void add_subvars_of_locals(ExecutionContext* ctx)
 {
 	Value a = ctx->local_variables[0];
@@ -148,40 +103,7 @@ void init_testing()
 	//{
 	//	o << i.offset() << "\t\t\t" << i.bytes_str() << "\t\t\t" << i.opcode().mnemonic() << "\n";
 	//}
-	/*Core::Proc p = "/proc/bench_intrinsic_add";
-	Disassembly d = p.disassemble();
-	Core::Proc intrinsic_add = "/proc/__intrinsic_add_locals";
-	std::vector<std::uint32_t>* new_bytecode = new std::vector<std::uint32_t>;
-	for (int i = 0; i < d.size(); i++)
-	{
-		if (d.at(i) == CALLGLOB && d.at(i).bytes().at(2) == intrinsic_add.id)
-		{
-			Instruction first_arg = d.at(i - 2);
-			Instruction second_arg = d.at(i - 1);
-			Instruction destination = d.at(i + 1);
-			new_bytecode->resize(new_bytecode->size() - 6);
-			int intrinsic_op = Core::register_opcode("INTRINSIC_ADD_NUMBERS_"+std::to_string(rand()), _generate_number_op_localm_localn_store_localx(ADD, first_arg.bytes().at(2), second_arg.bytes().at(2), destination.bytes().at(2)));
-			new_bytecode->push_back(intrinsic_op);
-			i += 1;
-		}
-		else
-		{
-			for (unsigned int& byte : d.at(i).bytes())
-			{
-				new_bytecode->push_back(byte);
-			}
-		}
-	}
-	for (int i = 0; i < 10; i++)
-	{
-		new_bytecode->push_back(0x00);
-	}
-	p.set_bytecode(new_bytecode);
-	std::ofstream o("out.txt");
-	for (Instruction& i : Core::get_proc("/proc/bench_dm_add").disassemble())
-	{
-		o << i.offset() << "\t\t\t" << i.bytes_str() << "\t\t\t" << i.opcode().mnemonic() << "\n";
-	}*//*
+	/*
 	bool find_unknowns = false;
 	if (find_unknowns)
 	{
@@ -214,18 +136,6 @@ void init_testing()
 	//Core::get_proc("/proc/measure_get_variable").hook(measure_get_variable);
 	//Core::get_proc("/proc/laugh").hook(show_profiles);
 
-	/*int hypotenuse_opcode = Core::register_opcode("CHEAP_HYPOTENUSE", cheap_hypotenuse_opcode);
-	Core::Proc& hypotenuse_bench = Core::get_proc("/proc/bench_cheap_hypotenuse_native");
-	Disassembly dis = hypotenuse_bench.disassemble();
-	for (Instruction& instr : dis)
-	{
-		if (instr == Bytecode::CALLGLOB)
-		{
-			instr = Instruction(hypotenuse_opcode);
-			break;
-		}
-	}
-	hypotenuse_bench.assemble(dis);*/
 }
 
 void run_tests()
@@ -0,0 +1,548 @@
+#include "breakpoint_condition.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	struct Parser
+	{
+		const std::string& text;
+		std::size_t pos = 0;
+
+		void skip_space()
+		{
+			while (pos < text.size() && std::isspace((unsigned char)text[pos]))
+			{
+				pos++;
+			}
+		}
+
+		bool done()
+		{
+			skip_space();
+			return pos >= text.size();
+		}
+
+		bool accept(const char* token)
+		{
+			skip_space();
+			std::size_t length = std::strlen(token);
+			if (text.compare(pos, length, token) == 0)
+			{
+				pos += length;
+				return true;
+			}
+			return false;
+		}
+
+		std::string identifier()
+		{
+			skip_space();
+			std::size_t start = pos;
+			while (pos < text.size() && (std::isalnum((unsigned char)text[pos]) || text[pos] == '_'))
+			{
+				pos++;
+			}
+			if (start < pos && std::isdigit((unsigned char)text[start]))
+			{
+				pos = start;
+			}
+			return text.substr(start, pos - start);
+		}
+
+		bool number(float& out)
+		{
+			skip_space();
+			const char* start = text.c_str() + pos;
+			char* end;
+			out = std::strtof(start, &end);
+			if (end == start)
+			{
+				return false;
+			}
+			pos += end - start;
+			return true;
+		}
+
+		bool string(std::string& out)
+		{
+			if (!accept("\""))
+			{
+				return false;
+			}
+			for (; pos < text.size(); pos++)
+			{
+				if (text[pos] == '"')
+				{
+					pos++;
+					return true;
+				}
+				if (text[pos] == '\\' && pos + 1 < text.size())
+				{
+					pos++;
+				}
+				out.push_back(text[pos]);
+			}
+			return false;
+		}
+	};
+
+	bool has_vars(DataType type)
+	{
+		switch (type)
+		{
+		case DataType::TURF:
+		case DataType::OBJ:
+		case DataType::MOB:
+		case DataType::AREA:
+		case DataType::CLIENT:
+		case DataType::IMAGE:
+		case DataType::WORLD_D:
+		case DataType::DATUM:
+		case DataType::SAVEFILE:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool is_list(DataType type)
+	{
+		switch (type)
+		{
+		case DataType::LIST:
+		case DataType::LIST_ARGS:
+		case DataType::LIST_MOB_VERBS:
+		case DataType::LIST_VERBS:
+		case DataType::LIST_TURF_VERBS:
+		case DataType::LIST_AREA_VERBS:
+		case DataType::LIST_CLIENT_VERBS:
+		case DataType::LIST_SAVEFILE_DIR:
+		case DataType::LIST_MOB_CONTENTS:
+		case DataType::LIST_TURF_CONTENTS:
+		case DataType::LIST_AREA_CONTENTS:
+		case DataType::LIST_WORLD_CONTENTS:
+		case DataType::LIST_GROUP:
+		case DataType::LIST_CONTENTS:
+		case DataType::LIST_MOB_VARS:
+		case DataType::LIST_OBJ_VARS:
+		case DataType::LIST_TURF_VARS:
+		case DataType::LIST_AREA_VARS:
+		case DataType::LIST_CLIENT_VARS:
+		case DataType::LIST_VARS:
+		case DataType::LIST_MOB_OVERLAYS:
+		case DataType::LIST_MOB_UNDERLAYS:
+		case DataType::LIST_OVERLAYS:
+		case DataType::LIST_UNDERLAYS:
+		case DataType::LIST_TURF_OVERLAYS:
+		case DataType::LIST_TURF_UNDERLAYS:
+		case DataType::LIST_AREA_OVERLAYS:
+		case DataType::LIST_AREA_UNDERLAYS:
+		case DataType::LIST_IMAGE_OVERLAYS:
+		case DataType::LIST_IMAGE_UNDERLAYS:
+		case DataType::LIST_IMAGE_VARS:
+		case DataType::LIST_IMAGE_VERBS:
+		case DataType::LIST_IMAGE_CONTENTS:
+		case DataType::LIST_CLIENT_IMAGES:
+		case DataType::LIST_CLIENT_SCREEN:
+		case DataType::LIST_TURF_VIS_CONTENTS:
+		case DataType::LIST_VIS_CONTENTS:
+		case DataType::LIST_MOB_VIS_CONTENTS:
+		case DataType::LIST_TURF_VIS_LOCS:
+		case DataType::LIST_VIS_LOCS:
+		case DataType::LIST_MOB_VIS_LOCS:
+		case DataType::LIST_WORLD_VARS:
+		case DataType::LIST_GLOBAL_VARS:
+		case DataType::LIST_IMAGE_VIS_CONTENTS:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// The same check as Value::has_var, without looking up "vars" and the name in the string table every time.
+	bool has_var(Value datum, std::uint32_t name_id)
+	{
+		static const std::uint32_t vars_id = Core::GetStringId("vars");
+		Value vars = GetVariable(datum.type, datum.value, vars_id);
+		return IsInContainer(DataType::STRING, name_id, vars.type, vars.value);
+	}
+
+	// Indexing a list out of range is a runtime, so the length is checked first. Plain lists are read directly.
+	bool list_at(Value list, const VarPath::Step& step, Value& out)
+	{
+		if (step.kind == VarPath::Step::Kind::KEY)
+		{
+			if (list.type == DataType::LIST)
+			{
+				RawList* raw = GetListPointerById(list.value);
+				if (!raw || !raw->is_assoc())
+				{
+					return false;
+				}
+			}
+			out = GetAssocElement(list.type, list.value, DataType::STRING, step.id);
+			return true;
+		}
+		if (list.type == DataType::LIST)
+		{
+			RawList* raw = GetListPointerById(list.value);
+			if (!raw || step.id < 1 || step.id > (std::uint32_t)raw->length)
+			{
+				return false;
+			}
+			out = raw->vector_part[step.id - 1];
+			return true;
+		}
+		int length = Length(list.type, list.value);
+		if (length < 0 || step.id < 1 || step.id > (std::uint32_t)length)
+		{
+			return false;
+		}
+		out = GetAssocElement(list.type, list.value, DataType::NUMBER, Value((float)step.id).value);
+		return true;
+	}
+
+	bool truthy(Value value)
+	{
+		switch (value.type)
+		{
+		case DataType::NULL_D:
+			return false;
+		case DataType::NUMBER:
+			return value.valuef != 0;
+		case DataType::STRING:
+			return GetStringTableEntry(value.value)->stringData[0] != 0;
+		default:
+			return true;
+		}
+	}
+}
+
+static std::uint32_t string_id(const std::string& text, std::unordered_map<std::string, std::uint32_t>* ids)
+{
+	if (!ids)
+	{
+		return Core::GetStringId(text);
+	}
+	auto [it, added] = ids->try_emplace(text, 0);
+	if (added)
+	{
+		it->second = Core::GetStringId(text);
+	}
+	return it->second;
+}
+
+static bool parse_var_path(Parser& parser, Core::Proc& proc, VarPath& out, std::string& error, std::unordered_map<std::string, std::uint32_t>* ids = nullptr)
+{
+	std::string name = parser.identifier();
+	if (name.empty())
+	{
+		error = "expected a variable at " + std::to_string(parser.pos);
+		return false;
+	}
+	if (name == "src" || name == "usr" || name == "global")
+	{
+		out.source = name == "src" ? VarPath::Source::SRC : name == "usr" ? VarPath::Source::USR : VarPath::Source::GLOBAL;
+	}
+	else
+	{
+		bool found = false;
+		for (std::uint32_t i = 0; i < proc.get_local_count() && !found; i++)
+		{
+			if (proc.get_local_name(i) == name)
+			{
+				out.source = VarPath::Source::LOCAL;
+				out.index = i;
+				found = true;
+			}
+		}
+		for (std::uint32_t i = 0; i < proc.get_param_count() && !found; i++)
+		{
+			if (proc.get_param_name(i) == name)
+			{
+				out.source = VarPath::Source::ARG;
+				out.index = i;
+				found = true;
+			}
+		}
+		if (!found)
+		{
+			error = proc.name + " has no local or argument named " + name;
+			return false;
+		}
+	}
+
+	std::string global_name;
+	while (true)
+	{
+		if (parser.accept("."))
+		{
+			std::string var = parser.identifier();
+			if (var.empty())
+			{
+				error = "expected a var name at " + std::to_string(parser.pos);
+				return false;
+			}
+			if (out.steps.empty())
+			{
+				global_name = var;
+			}
+			out.steps.push_back({ VarPath::Step::Kind::VAR, string_id(var, ids) });
+		}
+		else if (parser.accept("["))
+		{
+			std::string key;
+			float number;
+			if (parser.string(key))
+			{
+				out.steps.push_back({ VarPath::Step::Kind::KEY, string_id(key, ids) });
+			}
+			else if (parser.number(number) && number >= 1 && number == (std::uint32_t)number)
+			{
+				out.steps.push_back({ VarPath::Step::Kind::INDEX, (std::uint32_t)number });
+			}
+			else
+			{
+				error = "expected an index or a \"key\" at " + std::to_string(parser.pos);
+				return false;
+			}
+			if (!parser.accept("]"))
+			{
+				error = "expected ] at " + std::to_string(parser.pos);
+				return false;
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (out.source == VarPath::Source::GLOBAL)
+	{
+		// Globals can be looked up without checking, as long as they exist now.
+		if (out.steps.empty() || out.steps[0].kind != VarPath::Step::Kind::VAR || !has_var(Value::Global(), out.steps[0].id))
+		{
+			error = global_name.empty() ? std::string("expected global.name") : "no global var named " + global_name;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool VarPath::compile(Core::Proc& proc, const std::string& text, VarPath& out, std::string& error)
+{
+	std::unordered_map<std::string, std::uint32_t> ids;
+	return compile(proc, text, out, error, ids);
+}
+
+bool VarPath::compile(Core::Proc& proc, const std::string& text, VarPath& out, std::string& error, std::unordered_map<std::string, std::uint32_t>& ids)
+{
+	Parser parser { text };
+	out = VarPath();
+	if (!parse_var_path(parser, proc, out, error, &ids))
+	{
+		return false;
+	}
+	if (!parser.done())
+	{
+		error = "unexpected " + text.substr(parser.pos);
+		return false;
+	}
+	return true;
+}
+
+bool VarPath::read(ExecutionContext* ctx, Value& out) const
+{
+	std::size_t first = 0;
+	switch (source)
+	{
+	case Source::LOCAL:
+		if (index >= ctx->local_var_count)
+		{
+			return false;
+		}
+		out = ctx->local_variables[index];
+		break;
+	case Source::ARG:
+		// Arguments that weren't passed are null.
+		out = index < ctx->constants->arg_count ? ctx->constants->args[index] : Value();
+		break;
+	case Source::SRC:
+		out = ctx->constants->src;
+		break;
+	case Source::USR:
+		out = ctx->constants->usr;
+		break;
+	case Source::GLOBAL:
+		out = GetVariable(DataType::WORLD_D, 0x01, steps[0].id);
+		first = 1;
+		break;
+	}
+	for (std::size_t i = first; i < steps.size(); i++)
+	{
+		const Step& step = steps[i];
+		if (step.kind != Step::Kind::VAR)
+		{
+			if (!is_list(out.type) || !list_at(out, step, out))
+			{
+				return false;
+			}
+			continue;
+		}
+		if (!has_vars(out.type) || !has_var(out, step.id))
+		{
+			return false;
+		}
+		out = GetVariable(out.type, out.value, step.id);
+	}
+	return true;
+}
+
+std::shared_ptr<BreakpointCondition> BreakpointCondition::compile(Core::Proc& proc, const std::string& condition, const std::string& hit_condition, std::string& error)
+{
+	auto result = std::make_shared<BreakpointCondition>();
+	if (!result->parse_condition(proc, condition, error) || !result->parse_hit_condition(hit_condition, error))
+	{
+		return nullptr;
+	}
+	return result;
+}
+
+bool BreakpointCondition::parse_condition(Core::Proc& proc, const std::string& text, std::string& error)
+{
+	Parser parser { text };
+	if (parser.done())
+	{
+		return true;
+	}
+	do
+	{
+		Clause clause;
+		if (!parse_var_path(parser, proc, clause.path, error))
+		{
+			return false;
+		}
+
+		// Longer operators first, so <= isn't read as <.
+		static const std::pair<const char*, Compare> operators[] = {
+			{ "==", Compare::EQ }, { "!=", Compare::NE }, { "<=", Compare::LE }, { ">=", Compare::GE }, { "<", Compare::LT }, { ">", Compare::GT },
+		};
+		clause.compare = Compare::TRUTHY;
+		for (const auto& [token, compare] : operators)
+		{
+			if (parser.accept(token))
+			{
+				clause.compare = compare;
+				break;
+			}
+		}
+		if (clause.compare != Compare::TRUTHY)
+		{
+			float number;
+			std::string string;
+			if (parser.accept("null"))
+			{
+				clause.constant = Value::Null();
+			}
+			else if (parser.string(string))
+			{
+				clause.constant = ManagedValue(string);
+			}
+			else if (parser.number(number))
+			{
+				clause.constant = Value(number);
+			}
+			else
+			{
+				error = "expected a number, string or null at " + std::to_string(parser.pos);
+				return false;
+			}
+		}
+		clauses.push_back(std::move(clause));
+	} while (parser.accept("&&"));
+
+	if (!parser.done())
+	{
+		error = "unexpected " + text.substr(parser.pos);
+		return false;
+	}
+	return true;
+}
+
+bool BreakpointCondition::parse_hit_condition(const std::string& text, std::string& error)
+{
+	Parser parser { text };
+	if (parser.done())
+	{
+		return true;
+	}
+	hit_mode = parser.accept("==") ? HitMode::EQUAL : parser.accept("%") ? HitMode::EVERY : HitMode::AT_LEAST;
+	if (hit_mode == HitMode::AT_LEAST)
+	{
+		parser.accept(">=");
+	}
+	float count;
+	if (!parser.number(count) || count < 1 || !parser.done())
+	{
+		error = "hit condition should be N, >= N, == N or % N";
+		return false;
+	}
+	hit_count = count;
+	return true;
+}
+
+bool BreakpointCondition::Clause::matches(ExecutionContext* ctx) const
+{
+	Value value;
+	if (!path.read(ctx, value))
+	{
+		return false;
+	}
+	if (compare == Compare::TRUTHY)
+	{
+		return truthy(value);
+	}
+	if (value.type == DataType::NUMBER && constant.type == DataType::NUMBER)
+	{
+		switch (compare)
+		{
+		case Compare::EQ: return value.valuef == constant.valuef;
+		case Compare::NE: return value.valuef != constant.valuef;
+		case Compare::LT: return value.valuef < constant.valuef;
+		case Compare::LE: return value.valuef <= constant.valuef;
+		case Compare::GT: return value.valuef > constant.valuef;
+		case Compare::GE: return value.valuef >= constant.valuef;
+		default: return false;
+		}
+	}
+	// Strings are interned, so everything else compares by identity. Ordering only makes sense for numbers.
+	bool same = value.type == constant.type && value.value == constant.value;
+	switch (compare)
+	{
+	case Compare::EQ: return same;
+	case Compare::NE: return !same;
+	default: return false;
+	}
+}
+
+bool BreakpointCondition::should_break(ExecutionContext* ctx)
+{
+	for (const Clause& clause : clauses)
+	{
+		if (!clause.matches(ctx))
+		{
+			return false;
+		}
+	}
+	hits++;
+	switch (hit_mode)
+	{
+	case HitMode::AT_LEAST: return hits >= hit_count;
+	case HitMode::EQUAL: return hits == hit_count;
+	case HitMode::EVERY: return hits % hit_count == 0;
+	default: return true;
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../core/core.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A variable compiled against one proc: a local or argument by name, src, usr or global, then any number of
+// .var lookups and [index] or ["key"] list lookups, like src.loc.contents[3].name or global.round_id.
+struct VarPath
+{
+	// Var names are looked up in the string table once, at compile time.
+	static bool compile(Core::Proc& proc, const std::string& text, VarPath& out, std::string& error);
+	// The same, but shares string ids between the paths compiled with the same `ids`.
+	static bool compile(Core::Proc& proc, const std::string& text, VarPath& out, std::string& error, std::unordered_map<std::string, std::uint32_t>& ids);
+
+	// False if a var along the way doesn't exist, or an index is out of range.
+	bool read(ExecutionContext* ctx, Value& out) const;
+
+	enum class Source : std::uint8_t
+	{
+		LOCAL,
+		ARG,
+		SRC,
+		USR,
+		GLOBAL,
+	};
+
+	struct Step
+	{
+		enum class Kind : std::uint8_t
+		{
+			VAR, // .name
+			INDEX, // [number], 1-based like DM
+			KEY, // ["string"]
+		};
+
+		Kind kind;
+		std::uint32_t id; // the string id of the var name or key, or the index
+	};
+
+	Source source = Source::LOCAL;
+	std::uint32_t index = 0; // local or arg number
+	std::vector<Step> steps; // a GLOBAL path starts with the global's name
+};
+
+// A breakpoint condition compiled against one proc, so checking it on a hit is a few loads and compares and
+// the debugger only hears about the hits that match.
+//
+// A condition is one or more clauses joined with &&. Each clause is a variable, optionally compared to a
+// constant with == != < <= > >=. A variable on its own is true unless it's null, 0 or "". Variables are
+// VarPaths, and constants are numbers, "strings" or null:
+//
+//	i > 10 && src.name == "bob"
+//
+// The hit condition decides which matching hits stop: "N" or ">= N" from the Nth on, "== N" only the Nth,
+// and "% N" every Nth.
+class BreakpointCondition
+{
+public:
+	// Empty strings are fine and mean no condition. Returns null and fills in `error` if either doesn't parse.
+	static std::shared_ptr<BreakpointCondition> compile(Core::Proc& proc, const std::string& condition, const std::string& hit_condition, std::string& error);
+
+	// Counts the hit if the condition matches.
+	bool should_break(ExecutionContext* ctx);
+
+	std::uint32_t hits = 0;
+
+private:
+	enum class Compare : std::uint8_t
+	{
+		TRUTHY,
+		EQ,
+		NE,
+		LT,
+		LE,
+		GT,
+		GE,
+	};
+
+	enum class HitMode : std::uint8_t
+	{
+		ALWAYS,
+		AT_LEAST,
+		EQUAL,
+		EVERY,
+	};
+
+	struct Clause
+	{
+		VarPath path;
+		Compare compare = Compare::TRUTHY;
+		ManagedValue constant = Value::Null();
+
+		bool matches(ExecutionContext* ctx) const;
+	};
+
+	std::vector<Clause> clauses;
+	HitMode hit_mode = HitMode::ALWAYS;
+	std::uint32_t hit_count = 0;
+
+	bool parse_condition(Core::Proc& proc, const std::string& text, std::string& error);
+	bool parse_hit_condition(const std::string& text, std::string& error);
+};
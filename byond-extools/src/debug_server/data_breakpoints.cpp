@@ -0,0 +1,135 @@
+#include "data_breakpoints.h"
+#include "debug_server.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+extern DebugServer debug_server;
+
+WatchSet::WatchSet(std::vector<Watch> watches) : list(std::move(watches))
+{
+	std::size_t size = 8;
+	while (size < list.size() * 2)
+	{
+		size *= 2;
+	}
+	slots.resize(size);
+	mask = size - 1;
+	for (const Watch& watch : list)
+	{
+		std::uint64_t h = hash(watch.object, watch.name);
+		bloom[(h & (BLOOM_BITS - 1)) / 64] |= 1ull << (h & 63);
+		bloom[((h >> 16) & (BLOOM_BITS - 1)) / 64] |= 1ull << ((h >> 16) & 63);
+		std::size_t i = (h >> 32) & mask;
+		while (slots[i].access)
+		{
+			i = (i + 1) & mask;
+		}
+		slots[i] = watch;
+	}
+}
+
+static SetVariablePtr oSetVariable;
+static GetVariablePtr oGetVariable;
+
+static std::atomic<const WatchSet*> current_watches = nullptr;
+static std::mutex watches_mutex; // for writers
+// The hooks may still be looking at a replaced set, so the last few are kept around. Sets are replaced on the
+// game thread between ticks or while it's paused, when it isn't inside a hook, so only a hook on some other
+// thread could still hold one, and it's long done by the time MAX_RETIRED_WATCHES more changes came through.
+static const std::size_t MAX_RETIRED_WATCHES = 16;
+static std::deque<std::unique_ptr<WatchSet>> retired_watches;
+static std::thread::id game_thread;
+static bool reporting = false;
+
+// Only stops the game thread: the debugger reads vars from its own thread while the game is paused.
+static bool should_report(std::uint8_t access, std::uint8_t kind)
+{
+	return (access & kind) && !reporting && std::this_thread::get_id() == game_thread && Core::get_context();
+}
+
+static void hSetVariable(trvh datum, unsigned int name_id, trvh new_value)
+{
+	const WatchSet* watches = current_watches.load(std::memory_order_acquire);
+	if (!watches || !should_report(watches->find(datum.type, datum.value, name_id), WatchSet::WRITE))
+	{
+		oSetVariable(datum.type, datum.value, name_id, new_value);
+		return;
+	}
+	Value old_value = oGetVariable ? oGetVariable(datum.type, datum.value, name_id) : GetVariable(datum.type, datum.value, name_id);
+	oSetVariable(datum.type, datum.value, name_id, new_value);
+	reporting = true;
+	debug_server.on_data_breakpoint(Core::get_context(), Value(datum), name_id, &old_value, Value(new_value));
+	reporting = false;
+}
+
+static trvh hGetVariable(int datum_type, int datum_id, unsigned int name_id)
+{
+	trvh value = oGetVariable(datum_type, datum_id, name_id);
+	const WatchSet* watches = current_watches.load(std::memory_order_acquire);
+	if (watches && should_report(watches->find((DataType)datum_type, datum_id, name_id), WatchSet::READ))
+	{
+		reporting = true;
+		debug_server.on_data_breakpoint(Core::get_context(), Value((DataType)datum_type, datum_id), name_id, nullptr, Value(value));
+		reporting = false;
+	}
+	return value;
+}
+
+bool DataBreakpoints::initialize()
+{
+	game_thread = std::this_thread::get_id();
+	// Ref tracking hooks SetVariable too, and hooks on the same function don't chain.
+	if (!Core::is_hooked((void*)SetVariable))
+	{
+		oSetVariable = Core::install_hook(SetVariable, (SetVariablePtr)hSetVariable);
+	}
+	if (!Core::is_hooked((void*)GetVariable))
+	{
+		oGetVariable = Core::install_hook(GetVariable, hGetVariable);
+	}
+	return true;
+}
+
+bool DataBreakpoints::set(Value datum, const std::string& name, std::uint8_t access, std::string& error)
+{
+	if (((access & WatchSet::WRITE) && !oSetVariable) || ((access & WatchSet::READ) && !oGetVariable))
+	{
+		error = "another module has already hooked variable access";
+		return false;
+	}
+	if (access && !datum.has_var(name))
+	{
+		error = "no var named " + name;
+		return false;
+	}
+	WatchSet::Watch watch { ((std::uint64_t)datum.type << 32) | (std::uint32_t)datum.value, Core::GetStringId(name), access };
+
+	std::lock_guard<std::mutex> lk(watches_mutex);
+	std::vector<WatchSet::Watch> watches;
+	if (const WatchSet* old = current_watches.load())
+	{
+		for (const WatchSet::Watch& existing : old->watches())
+		{
+			if (existing.object != watch.object || existing.name != watch.name)
+			{
+				watches.push_back(existing);
+			}
+		}
+	}
+	if (access)
+	{
+		watches.push_back(watch);
+	}
+	auto replacement = std::make_unique<WatchSet>(std::move(watches));
+	current_watches.store(replacement->watches().empty() ? nullptr : replacement.get(), std::memory_order_release);
+	retired_watches.push_back(std::move(replacement));
+	if (retired_watches.size() > MAX_RETIRED_WATCHES)
+	{
+		retired_watches.pop_front();
+	}
+	return true;
+}
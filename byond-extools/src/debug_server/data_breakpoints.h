@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../core/core.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+// The vars being watched, checked by the SetVariable and GetVariable hooks on every call. A bloom filter in
+// front of a small open-addressed table means a var that isn't watched usually costs two bit tests. Sets are
+// never modified: changing the watches builds a new one.
+class WatchSet
+{
+public:
+	enum Access : std::uint8_t
+	{
+		READ = 1,
+		WRITE = 2,
+	};
+
+	struct Watch
+	{
+		std::uint64_t object; // type << 32 | id
+		std::uint32_t name; // string id
+		std::uint8_t access; // Access bits, 0 for an empty slot
+	};
+
+	explicit WatchSet(std::vector<Watch> watches);
+
+	// The Access bits watched on this var, 0 if none.
+	std::uint8_t find(DataType type, int id, unsigned int name) const
+	{
+		std::uint64_t object = ((std::uint64_t)type << 32) | (std::uint32_t)id;
+		std::uint64_t h = hash(object, name);
+		if (!(bloom[(h & (BLOOM_BITS - 1)) / 64] & (1ull << (h & 63))) ||
+			!(bloom[((h >> 16) & (BLOOM_BITS - 1)) / 64] & (1ull << ((h >> 16) & 63))))
+		{
+			return 0;
+		}
+		for (std::size_t i = (h >> 32) & mask;; i = (i + 1) & mask)
+		{
+			const Watch& slot = slots[i];
+			if (!slot.access)
+			{
+				return 0;
+			}
+			if (slot.object == object && slot.name == name)
+			{
+				return slot.access;
+			}
+		}
+	}
+
+	const std::vector<Watch>& watches() const { return list; }
+
+private:
+	static const std::size_t BLOOM_BITS = 4096;
+
+	static std::uint64_t hash(std::uint64_t object, std::uint32_t name)
+	{
+		// splitmix64's finalizer
+		std::uint64_t h = object * 0x9E3779B97F4A7C15ull ^ name;
+		h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+		h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+		return h ^ (h >> 31);
+	}
+
+	std::array<std::uint64_t, BLOOM_BITS / 64> bloom {};
+	std::vector<Watch> slots; // at most half full, so probes stay short and always end
+	std::size_t mask;
+	std::vector<Watch> list;
+};
+
+namespace DataBreakpoints
+{
+	// Hooks SetVariable and GetVariable. Call from the main thread.
+	bool initialize();
+	// Watches `name` on `datum` for the given Access bits, or stops watching it if `access` is 0. Looks up the
+	// var, so call it where BYOND isn't running procs: see DebugServer::on_game_thread.
+	bool set(Value datum, const std::string& name, std::uint8_t access, std::string& error);
+}
@@ -1,8 +1,18 @@
 #include "debug_server.h"
+#include "data_breakpoints.h"
+#include "heap_census.h"
+#include "profile_stream.h"
 #include "../dmdism/disassembly.h"
 #include "../dmdism/disassembler.h"
 #include "../dmdism/opcodes.h"
+#include "../dmdism/opcodes_enum.h"
+#include "../profiler/profiler.h"
+#include "../profiler/line_profiler.h"
+#include "../profiler/opcode_histogram.h"
+#include "../indexer/indexer.h"
 #include "../third_party/json.hpp"
+#include <algorithm>
+#include <cstring>
 #include <utility>
 #include <unordered_map>
 
@@ -16,7 +26,6 @@ std::mutex notifier_mutex;
 std::condition_variable notifier;
 
 RuntimePtr oRuntime;
-//GetVariablePtr oGetVariable;
 
 bool DebugServer::listen(const char* port)
 {
@@ -45,9 +54,9 @@ nlohmann::json value_to_text(Value val);
 
 DataType datatype_name_to_val(std::string name)
 {
-	for (auto it = datatype_names.begin(); it != datatype_names.end(); ++it)
-		if (it->second == name)
-			return it->first;
+	for (unsigned int type = 0; type < 0x100; type++)
+		if (const char* type_name = datatype_name(type); type_name && type_name == name)
+			return (DataType)type;
 	return DataType::NULL_D;
 }
 
@@ -73,7 +82,7 @@ try
 	{
 		const std::string& echoing = data.at("content");
 		Core::Alert("Echoing: " + echoing);
-		debugger.send(MESSAGE_RAW, echoing);
+		reply({ { "type", MESSAGE_RAW }, { "content", echoing } });
 	}
 	else if (type == MESSAGE_PROC_LIST)
 	{
@@ -82,7 +91,7 @@ try
 		{
 			procs.push_back({ {"proc", proc.name}, {"override_id", proc.override_id} });
 		}
-		debugger.send(MESSAGE_PROC_LIST, procs);
+		reply({ { "type", MESSAGE_PROC_LIST }, { "content", procs } });
 	}
 	else if (type == MESSAGE_PROC_DISASSEMBLY)
 	{
@@ -111,61 +120,80 @@ try
 			instructions.push_back(d_instr);
 		}
 		disassembled_proc["instructions"] = instructions;
-		debugger.send(MESSAGE_PROC_DISASSEMBLY, disassembled_proc);
+		reply({ { "type", MESSAGE_PROC_DISASSEMBLY }, { "content", disassembled_proc } });
 	}
 	else if (type == MESSAGE_BREAKPOINT_SET)
 	{
-		//Core::Alert("BREAKPOINT_SET");
-		auto content = data.at("content");
-		const std::string& proc = content.at("proc");
-		const int& override_id = content.at("override_id");
-		//Core::Alert("Setting breakpoint in " + proc);
-		set_breakpoint(Core::get_proc(proc, override_id).id, content.at("offset"));
-		debugger.send(data);
+		// Compiling conditions looks up strings and globals, and on_breakpoint reads what gets installed.
+		on_game_thread([this, data]() mutable {
+			//Core::Alert("BREAKPOINT_SET");
+			auto content = data.at("content");
+			const std::string& proc = content.at("proc");
+			const int& override_id = content.at("override_id");
+			//Core::Alert("Setting breakpoint in " + proc);
+			Core::Proc& p = Core::get_proc(proc, override_id);
+			int offset = content.at("offset");
+			std::string error;
+			std::shared_ptr<BreakpointCondition> condition;
+			std::shared_ptr<Logpoint> log;
+			if (content.contains("condition") || content.contains("hit_condition"))
+			{
+				condition = BreakpointCondition::compile(p, content.value("condition", ""), content.value("hit_condition", ""), error);
+			}
+			if (error.empty() && content.contains("log_message"))
+			{
+				log = Logpoint::compile(p, offset, content.at("log_message"), error);
+			}
+			if (error.empty())
+			{
+				set_breakpoint(p.id, offset, content.value("one_shot", false), condition, log);
+			}
+			else
+			{
+				data["content"]["error"] = error;
+			}
+			reply(data);
+		});
 	}
 	else if (type == MESSAGE_BREAKPOINT_UNSET)
 	{
-		auto content = data.at("content");
-		const std::string& proc = content.at("proc");
-		const int& override_id = content.at("override_id");
-		//Core::Alert("Setting breakpoint in " + proc);
-		remove_breakpoint(Core::get_proc(proc, override_id).id, content.at("offset"));
-		debugger.send(data);
+		// Queued behind any set of the same breakpoint.
+		on_game_thread([this, data]() {
+			auto content = data.at("content");
+			const std::string& proc = content.at("proc");
+			const int& override_id = content.at("override_id");
+			//Core::Alert("Setting breakpoint in " + proc);
+			remove_breakpoint(Core::get_proc(proc, override_id).id, content.at("offset"));
+			reply(data);
+		});
 	}
 	else if (type == MESSAGE_BREAKPOINT_STEP_INTO)
 	{
-		std::lock_guard<std::mutex> lk(notifier_mutex);
-		next_action = NextAction::STEP_INTO;
-		notifier.notify_all();
+		continue_with(NextAction::STEP_INTO);
 	}
 	else if (type == MESSAGE_BREAKPOINT_STEP_OVER)
 	{
-		std::lock_guard<std::mutex> lk(notifier_mutex);
-		next_action = NextAction::STEP_OVER;
-		notifier.notify_all();
+		continue_with(NextAction::STEP_OVER);
 	}
 	else if (type == MESSAGE_BREAKPOINT_STEP_OUT)
 	{
-		std::lock_guard<std::mutex> lk(notifier_mutex);
-		next_action = NextAction::STEP_OUT;
-		notifier.notify_all();
+		continue_with(NextAction::STEP_OUT);
 	}
 	else if (type == MESSAGE_BREAKPOINT_PAUSE)
 	{
 		debug_server.step_mode = StepMode::PAUSE;
+		debug_server.update_singlestep();
 	}
 	else if (type == MESSAGE_BREAKPOINT_RESUME)
 	{
-		std::lock_guard<std::mutex> lk(notifier_mutex);
-		next_action = NextAction::RESUME;
-		notifier.notify_all();
+		continue_with(NextAction::RESUME);
 	}
 	else if (type == MESSAGE_GET_FIELD)
 	{
 		auto content = data.at("content");
 		int ref = content.at("ref");
 		data["content"] = value_to_text(Value((DataType)(ref >> 24), ref & 0xffffff).get_safe(content.at("field_name")));
-		debugger.send(data);
+		reply(data);
 	}
 	else if (type == MESSAGE_GET_ALL_FIELDS)
 	{
@@ -177,17 +205,73 @@ try
 			vals[v.first] = value_to_text(v.second);
 		}
 		data["content"] = vals;
-		debugger.send(data);
+		reply(data);
 	}
 	else if (type == MESSAGE_GET_GLOBAL)
 	{
 		data["content"] = value_to_text(GetVariable(DataType::WORLD_D, 0x01, Core::GetStringId(data.at("content"))));
-		debugger.send(data);
+		reply(data);
+	}
+	else if (type == MESSAGE_DATA_BREAKPOINT_SET || type == MESSAGE_DATA_BREAKPOINT_UNSET)
+	{
+		auto content = data.at("content");
+		int ref = content.at("ref");
+		std::uint8_t access = 0;
+		if (type == MESSAGE_DATA_BREAKPOINT_SET)
+		{
+			std::string kind = content.value("access", "write");
+			access = kind == "read" ? WatchSet::READ : kind == "readWrite" ? WatchSet::READ | WatchSet::WRITE : WatchSet::WRITE;
+		}
+		on_game_thread([this, data, content, ref, access]() mutable {
+			std::string error;
+			nlohmann::json response = nlohmann::json::object();
+			if (!DataBreakpoints::set(Value((DataType)(ref >> 24), ref & 0xffffff), content.at("field_name"), access, error))
+			{
+				response["error"] = error;
+			}
+			data["content"] = response;
+			reply(data);
+		});
 	}
 	else if (type == MESSAGE_TOGGLE_BREAK_ON_RUNTIME)
 	{
 		break_on_runtimes = data.at("content"); //runtimes funtimes
-		debugger.send(data);
+		reply(data);
+	}
+	else if (type == MESSAGE_LOGPOINT_FILE)
+	{
+		if (!Logpoints::set_file(data.at("content")))
+		{
+			data["content"] = "";
+		}
+		reply(data);
+	}
+	else if (type == MESSAGE_LAZY_CALL_STACKS)
+	{
+		lazy_call_stacks = data.at("content");
+		reply(data);
+	}
+	else if (type == MESSAGE_GET_SUSPENDED_STACKS)
+	{
+		auto content = data.at("content");
+		if (content.is_null())
+		{
+			content = nlohmann::json::object();
+		}
+		data["content"] = get_suspended_stacks(content.value("start", 0), content.value("count", 50));
+		reply(data);
+	}
+	else if (type == MESSAGE_GET_STACK_FRAME)
+	{
+		auto content = data.at("content");
+		data["content"] = get_stack_frame(content.value("stack", -1), content.at("frame"));
+		reply(data);
+	}
+	else if (type == MESSAGE_EVALUATE)
+	{
+		auto content = data.at("content");
+		data["content"] = evaluate(content.value("stack", -1), content.value("frame", 0), content.at("paths").get<std::vector<std::string>>());
+		reply(data);
 	}
 	else if (type == MESSAGE_GET_LIST_CONTENTS)
 	{
@@ -213,19 +297,33 @@ try
 				}
 				data["content"] = { { "associative", textual } };
 			}
-			debugger.send(data);
+			reply(data);
 		}
 		catch (const char* e) { //thrown by list constructor when trying to access an invalid list
 			data["content"] = { {"linear", std::vector<nlohmann::json>()} };
-			debugger.send(data);
+			reply(data);
 		}
 	}
 	else if (type == MESSAGE_GET_SOURCE)
 	{
 		data["content"] = StdDefDM ? std::string(StdDefDM(nullptr)) : "";
-		debugger.send(data);
+		reply(data);
 	}
 
+	else if (type == MESSAGE_XREF)
+	{
+		nlohmann::json& content = data.at("content");
+		nlohmann::json references = Indexer::query(content.at("kind"), content.at("subject"));
+		if (references.is_object())
+		{
+			content["error"] = references["error"];
+		}
+		else
+		{
+			content["references"] = std::move(references);
+		}
+		reply(data);
+	}
 	else if (type == MESSAGE_GET_PROFILE)
 	{
 		const std::string& name = data.at("content");
@@ -235,13 +333,56 @@ try
 		nlohmann::json resp;
 		resp["name"] = name;
 		resp["call_count"] = entry->call_count;
-		resp["self"] = { {"seconds", entry->self.seconds}, {"microseconds", entry->self.seconds} };
-		resp["total"] = { {"seconds", entry->total.seconds}, {"microseconds", entry->total.seconds} };
-		resp["real"] = { {"seconds", entry->real.seconds}, {"microseconds", entry->real.seconds} };
-		resp["overtime"] = { {"seconds", entry->overtime.seconds}, {"microseconds", entry->overtime.seconds} };
+		resp["self"] = Profiler::time_to_json(entry->self.as_microseconds());
+		resp["total"] = Profiler::time_to_json(entry->total.as_microseconds());
+		resp["real"] = Profiler::time_to_json(entry->real.as_microseconds());
+		resp["overtime"] = Profiler::time_to_json(entry->overtime.as_microseconds());
 
 		data["content"] = resp;
-		debugger.send(data);
+		reply(data);
+	}
+	else if (type == MESSAGE_GET_PROFILE_DELTA)
+	{
+		nlohmann::json content = data.at("content");
+		if (!content.is_object())
+		{
+			content = nlohmann::json::object();
+		}
+		Profiler::SortKey key = Profiler::sort_key_from_string(content.value("sort", "self"));
+		std::size_t count = content.value("count", 20);
+		std::vector<Profiler::Delta> deltas = profile_tracker.advance(profile_table, key, count);
+		data["content"] = Profiler::deltas_to_json(deltas, profile_tracker.seconds_since_last());
+		reply(data);
+	}
+	else if (type == MESSAGE_PROFILE_SUBSCRIBE)
+	{
+		nlohmann::json content = data.at("content");
+		if (content.is_object())
+		{
+			std::uint32_t interval = std::max(content.value("interval_ms", 1000u), 50u);
+			std::size_t count = content.value("count", 20);
+			std::string sort = content.value("sort", "self");
+			ProfileStream::subscribe(profile_table, std::chrono::milliseconds(interval), count, Profiler::sort_key_from_string(sort));
+			data["content"] = { { "interval_ms", interval }, { "count", count }, { "sort", sort } };
+		}
+		else
+		{
+			ProfileStream::unsubscribe();
+			data["content"] = nullptr;
+		}
+		reply(data);
+	}
+	else if (type == MESSAGE_HEAP_CENSUS)
+	{
+		nlohmann::json content = data.at("content");
+		if (!content.is_object())
+		{
+			content = nlohmann::json::object();
+		}
+		std::string error;
+		std::uint32_t id = HeapCensus::start(std::chrono::microseconds(content.value("budget_us", 1000)), content.value("chunk_size", 500), error);
+		data["content"] = id ? nlohmann::json { { "census", id } } : nlohmann::json { { "error", error } };
+		reply(data);
 	}
 	else if (type == MESSAGE_TOGGLE_PROFILER)
 	{
@@ -254,7 +395,20 @@ try
 		{
 			Core::disable_profiling();
 		}
-		debugger.send(data);
+		reply(data);
+	}
+	else if (type == MESSAGE_FRAMING)
+	{
+		Framing framing;
+		if (!framing_from_string(data.at("content"), framing))
+		{
+			framing = debugger.get_framing();
+		}
+		// The reply still uses the old framing, everything after it the new one.
+		data["content"] = framing_name(framing);
+		reply(data);
+		debugger.set_framing(framing);
+		outbox.set_framing(framing);
 	}
 	else if (type == MESSAGE_CONFIGURATION_DONE)
 	{
@@ -264,7 +418,8 @@ try
 }
 catch (const std::exception& e)
 {
-	Core::Alert(e.what());
+	// An alert would block until someone dismisses it on the server.
+	send(MESSAGE_PROTOCOL_ERROR, e.what(), Delivery::RELIABLE);
 	return HandleMessageResult::CONTINUE;
 }
 
@@ -298,6 +453,20 @@ bool DebugServer::loop_until_configured()
 	return true;
 }
 
+void DebugServer::continue_with(NextAction action)
+{
+	std::lock_guard<std::mutex> lk(notifier_mutex);
+	next_action = action;
+	paused = false;
+	notifier.notify_all();
+}
+
+bool DebugServer::is_paused()
+{
+	std::lock_guard<std::mutex> lk(notifier_mutex);
+	return paused;
+}
+
 NextAction DebugServer::wait_for_action()
 {
 	std::unique_lock<std::mutex> lk(notifier_mutex);
@@ -307,20 +476,44 @@ NextAction DebugServer::wait_for_action()
 	return res;
 }
 
-void DebugServer::send_simple(std::string message_type)
+void DebugServer::send_simple(const char* message_type, Delivery delivery)
+{
+	outbox.push(message_type, { {"type", message_type} }, delivery);
+}
+
+void DebugServer::send(const char* message_type, nlohmann::json content, Delivery delivery)
 {
-	debugger.send({ {"type", message_type} });
+	outbox.push(message_type, { {"type", message_type}, {"content", std::move(content) } }, delivery);
 }
 
-void DebugServer::send(std::string message_type, nlohmann::json content)
+void DebugServer::reply(nlohmann::json message)
 {
-	debugger.send({ {"type", message_type}, {"content", content } });
+	std::string type = message.at("type");
+	outbox.push(type.c_str(), std::move(message), Delivery::RELIABLE);
 }
 
-void DebugServer::set_breakpoint(int proc_id, int offset, bool singleshot)
+void DebugServer::on_game_thread(std::function<void()> job)
+{
+	if ((std::this_thread::get_id() == game_thread || is_paused()) && queued_jobs == 0)
+	{
+		job();
+		return;
+	}
+	queued_jobs++;
+	Core::run_between_ticks([this, job = std::move(job)]() {
+		job();
+		queued_jobs--;
+	});
+}
+
+void DebugServer::set_breakpoint(int proc_id, int offset, bool singleshot, std::shared_ptr<BreakpointCondition> condition, std::shared_ptr<Logpoint> log)
 {
 	if (get_breakpoint(proc_id, offset))
 	{
+		Breakpoint& bp = breakpoints[proc_id][offset];
+		bp.one_shot = singleshot;
+		bp.condition = condition;
+		bp.log = log;
 		return;
 	}
 	Core::Proc& proc = Core::get_proc(proc_id);
@@ -329,7 +522,9 @@ void DebugServer::set_breakpoint(int proc_id, int offset, bool singleshot)
 		&proc, //because this will ensure any running procs will also hit this
 		bytecode[offset],
 		(unsigned short)offset,
-		singleshot
+		singleshot,
+		condition,
+		log
 	};
 	bytecode[offset] = breakpoint_opcode;
 	breakpoints[proc_id][offset] = bp;
@@ -364,6 +559,7 @@ void DebugServer::remove_breakpoint(int proc_id, int offset)
 	bytecode[bp->offset] = bp->replaced_opcode;
 	breakpoints[proc_id].erase(offset);
 	breakpoint_to_restore = {};
+	update_singlestep();
 }
 
 void DebugServer::restore_breakpoint()
@@ -376,19 +572,81 @@ void DebugServer::restore_breakpoint()
 	std::uint32_t* bytecode = breakpoint_to_restore->proc->get_bytecode();
 	std::swap(bytecode[breakpoint_to_restore->offset], breakpoint_to_restore->replaced_opcode);
 	breakpoint_to_restore = {};
+	update_singlestep();
+}
+
+static std::mutex singlestep_update_mutex;
+static bool holding_singlestep = false;
+
+void DebugServer::update_singlestep()
+{
+	std::lock_guard<std::mutex> lk(singlestep_update_mutex);
+	bool needed = step_mode != StepMode::NONE || breakpoint_to_restore;
+	if (needed == holding_singlestep)
+	{
+		return;
+	}
+	if (!needed)
+	{
+		singlestep_release();
+	}
+	else if (!singlestep_acquire())
+	{
+		return;
+	}
+	holding_singlestep = needed;
 }
 
 void DebugServer::on_breakpoint(ExecutionContext* ctx)
 {
 	auto bp = get_breakpoint(ctx->constants->proc_id, ctx->current_opcode);
-	std::swap(ctx->bytecode[bp->offset], bp->replaced_opcode);
-	if (!bp->one_shot)
+	// Checked here so breakpoints in hot procs don't cost a round trip to the debugger on every hit.
+	bool fired = !bp->condition || bp->condition->should_break(ctx);
+	if (fired && bp->log)
+	{
+		bp->log->hit(ctx);
+	}
+	else if (fired)
 	{
+		send_call_stacks(ctx);
+		send(MESSAGE_BREAKPOINT_HIT, { {"proc", bp->proc->name }, {"offset", bp->offset }, {"override_id", Core::get_proc(ctx).override_id}, {"reason", "breakpoint opcode"} }, Delivery::BLOCKING);
+		on_break(ctx);
+	}
+	step_past_breakpoint(ctx, *bp, fired && bp->one_shot);
+}
+
+void DebugServer::step_past_breakpoint(ExecutionContext* ctx, Breakpoint bp, bool remove)
+{
+	std::uint32_t* bytecode = ctx->bytecode;
+	if (remove)
+	{
+		bytecode[bp.offset] = bp.replaced_opcode;
+		breakpoints[ctx->constants->proc_id].erase(bp.offset);
+	}
+
+	// Breakpoints almost always sit on line markers, which are simple enough to run right here. The breakpoint
+	// stays in place, so passing it costs just this one dispatch.
+	switch ((Bytecode)bp.replaced_opcode)
+	{
+	case Bytecode::DBG_FILE:
+		ctx->dbg_proc_file = bytecode[bp.offset + 1];
+		ctx->current_opcode++;
+		return;
+	case Bytecode::DBG_LINENO:
+		ctx->dbg_current_line = bytecode[bp.offset + 1];
+		ctx->current_opcode++;
+		return;
+	default:
+		break;
+	}
+
+	// Anything else runs the original instruction, and on_singlestep puts the breakpoint back after it.
+	if (!remove)
+	{
+		std::swap(bytecode[bp.offset], bp.replaced_opcode);
 		breakpoint_to_restore = bp;
+		update_singlestep();
 	}
-	send_call_stacks(ctx);
-	send(MESSAGE_BREAKPOINT_HIT, { {"proc", bp->proc->name }, {"offset", bp->offset }, {"override_id", Core::get_proc(ctx).override_id}, {"reason", "breakpoint opcode"} });
-	on_break(ctx);
 	ctx->current_opcode--;
 }
 
@@ -396,7 +654,25 @@ void DebugServer::on_step(ExecutionContext* ctx, const char* reason)
 {
 	auto& proc = Core::get_proc(ctx);
 	send_call_stacks(ctx);
-	send(MESSAGE_BREAKPOINT_HIT, { {"proc", proc.name }, {"offset", ctx->current_opcode }, {"override_id", proc.override_id}, {"reason", reason} });
+	send(MESSAGE_BREAKPOINT_HIT, { {"proc", proc.name }, {"offset", ctx->current_opcode }, {"override_id", proc.override_id}, {"reason", reason} }, Delivery::BLOCKING);
+	on_break(ctx);
+}
+
+void DebugServer::on_data_breakpoint(ExecutionContext* ctx, Value datum, unsigned int name_id, const Value* old_value, Value value)
+{
+	send_call_stacks(ctx);
+	nlohmann::json content = { { "ref", (datum.type << 24) | datum.value }, { "field_name", Core::GetStringFromId(name_id) } };
+	if (old_value)
+	{
+		content["old_value"] = value_to_text(*old_value);
+		content["new_value"] = value_to_text(value);
+		send(MESSAGE_DATA_BREAKPOINT_WRITE, content, Delivery::BLOCKING);
+	}
+	else
+	{
+		content["value"] = value_to_text(value);
+		send(MESSAGE_DATA_BREAKPOINT_READ, content, Delivery::BLOCKING);
+	}
 	on_break(ctx);
 }
 
@@ -429,14 +705,17 @@ void DebugServer::on_break(ExecutionContext* ctx)
 		step_mode = StepMode::NONE;
 		break;
 	}
+	update_singlestep();
+	paused_context = nullptr;
 }
 
 void DebugServer::on_error(ExecutionContext* ctx, const char* error)
 {
 	Core::Proc& p = Core::get_proc(ctx);
 	send_call_stacks(ctx);
-	debug_server.send(MESSAGE_RUNTIME, { {"proc", p.name }, {"offset", ctx->current_opcode }, {"override_id", p.override_id}, {"message", std::string(error)} });
+	debug_server.send(MESSAGE_RUNTIME, { {"proc", p.name }, {"offset", ctx->current_opcode }, {"override_id", p.override_id}, {"message", std::string(error)} }, Delivery::BLOCKING);
 	debug_server.wait_for_action();
+	paused_context = nullptr;
 }
 
 nlohmann::json value_to_text(Value val)
@@ -516,14 +795,44 @@ nlohmann::json value_to_text(Value val)
 	return result;
 }
 
-nlohmann::json frame_to_json(ExecutionContext* frame)
+struct ProcNames
+{
+	nlohmann::json locals;
+	nlohmann::json args;
+};
+
+// Every break used to look these up again for every frame, suspended ones included.
+static const ProcNames& proc_names(Core::Proc& p)
+{
+	static std::mutex mutex;
+	static std::unordered_map<std::uint32_t, ProcNames> cache;
+	std::lock_guard<std::mutex> lk(mutex);
+	auto [it, inserted] = cache.try_emplace(p.id);
+	if (inserted)
+	{
+		std::vector<std::string> local_names;
+		for (int i = 0; i < p.get_local_count(); ++i)
+			local_names.push_back(p.get_local_name(i));
+		it->second.locals = local_names;
+
+		std::vector<std::string> arg_names;
+		for (int i = 0; i < p.get_param_count(); ++i)
+			arg_names.push_back(p.get_param_name(i));
+		it->second.args = arg_names;
+	}
+	return it->second;
+}
+
+nlohmann::json frame_summary(ExecutionContext* frame)
 {
-	nlohmann::json j;
 	Core::Proc& p = Core::get_proc(frame);
+	return { {"proc", p.name}, {"override_id", p.override_id}, {"offset", frame->current_opcode} };
+}
 
-	j["proc"] = p.name;
-	j["override_id"] = p.override_id;
-	j["offset"] = frame->current_opcode;
+nlohmann::json frame_to_json(ExecutionContext* frame)
+{
+	nlohmann::json j = frame_summary(frame);
+	Core::Proc& p = Core::get_proc(frame);
 
 	j["usr"] = value_to_text(frame->constants->usr);
 	j["src"] = value_to_text(frame->constants->src);
@@ -539,48 +848,165 @@ nlohmann::json frame_to_json(ExecutionContext* frame)
 		args.push_back(value_to_text(frame->constants->args[i]));
 	j["args"] = args;
 
-	std::vector<std::string> local_names;
-	for (int i = 0; i < p.get_local_count(); ++i)
-		local_names.push_back(p.get_local_name(i));
-	j["local_names"] = local_names;
-
-	std::vector<std::string> arg_names;
-	for (int i = 0; i < p.get_param_count(); ++i)
-		arg_names.push_back(p.get_param_name(i));
-	j["arg_names"] = arg_names;
+	const ProcNames& names = proc_names(p);
+	j["local_names"] = names.locals;
+	j["arg_names"] = names.args;
 	return j;
 }
 
+// Innermost frame first.
+static std::vector<ExecutionContext*> current_frames(ExecutionContext* ctx)
+{
+	std::vector<ExecutionContext*> frames;
+	for (; ctx != nullptr; ctx = ctx->parent_context)
+	{
+		frames.push_back(ctx);
+	}
+	return frames;
+}
+
+static std::vector<ExecutionContext*> suspended_frames(ProcConstants* inst)
+{
+	std::vector<ExecutionContext*> frames = current_frames(inst->context);
+	// Suspended procs have their call stack flipped, so we have to reverse it to see something sane
+	std::reverse(frames.begin(), frames.end());
+	return frames;
+}
+
+static std::uint32_t suspended_count()
+{
+	return Core::suspended_proc_list->back - Core::suspended_proc_list->front;
+}
+
 void DebugServer::send_call_stacks(ExecutionContext* ctx)
 {
-	std::vector<nlohmann::json> current_frames;
-	do
 	{
-		current_frames.push_back(frame_to_json(ctx));
-	} while(ctx = ctx->parent_context);
-	
+		std::lock_guard<std::mutex> lk(notifier_mutex);
+		paused = true;
+	}
+	paused_context = ctx;
+	nlohmann::json stacks;
+	if (lazy_call_stacks)
+	{
+		std::vector<nlohmann::json> current;
+		for (ExecutionContext* frame : current_frames(ctx))
+		{
+			current.push_back(frame_summary(frame));
+		}
+		stacks["current"] = current;
+		stacks["suspended_count"] = suspended_count();
+		debug_server.send(MESSAGE_CALL_STACK, stacks, Delivery::RELIABLE);
+		return;
+	}
+
+	std::vector<nlohmann::json> current;
+	for (ExecutionContext* frame : current_frames(ctx))
+	{
+		current.push_back(frame_to_json(frame));
+	}
 
 	std::vector<nlohmann::json> suspended;
 	for (uint32_t i = Core::suspended_proc_list->front; i < Core::suspended_proc_list->back; i++)
 	{
 		std::vector<nlohmann::json> frames;
-		ProcConstants* inst = Core::suspended_proc_list->buffer[i];
-
-		for (ExecutionContext* ctx = inst->context; ctx != nullptr; ctx = ctx->parent_context)
+		for (ExecutionContext* frame : suspended_frames(Core::suspended_proc_list->buffer[i]))
 		{
-			frames.push_back(frame_to_json(ctx));
+			frames.push_back(frame_to_json(frame));
 		}
-
-		// Suspended procs have their call stack flipped, so we have to reverse it to see something sane
-		std::reverse(frames.begin(), frames.end());
-		
 		suspended.push_back(frames);
 	}
 
-	nlohmann::json stacks;
-	stacks["current"] = current_frames;
+	stacks["current"] = current;
 	stacks["suspended"] = suspended;
-	debug_server.send(MESSAGE_CALL_STACK, stacks);
+	debug_server.send(MESSAGE_CALL_STACK, stacks, Delivery::RELIABLE);
+}
+
+// Stack ids are positions in the suspended proc list, which only stay put while the game is paused.
+nlohmann::json DebugServer::get_suspended_stacks(std::uint32_t start, std::uint32_t count)
+{
+	if (!is_paused())
+	{
+		return { {"error", "not paused"} };
+	}
+	std::uint32_t total = suspended_count();
+	std::vector<nlohmann::json> stacks;
+	for (std::uint32_t id = start; id < total && id - start < count; id++)
+	{
+		std::vector<nlohmann::json> frames;
+		for (ExecutionContext* frame : suspended_frames(Core::suspended_proc_list->buffer[Core::suspended_proc_list->front + id]))
+		{
+			frames.push_back(frame_summary(frame));
+		}
+		stacks.push_back({ {"id", id}, {"frames", frames} });
+	}
+	return { {"total", total}, {"stacks", stacks} };
+}
+
+ExecutionContext* DebugServer::find_frame(std::int64_t stack, std::uint32_t frame, std::string& error)
+{
+	if (!is_paused())
+	{
+		error = "not paused";
+		return nullptr;
+	}
+	std::vector<ExecutionContext*> frames;
+	if (stack < 0)
+	{
+		frames = current_frames(paused_context);
+	}
+	else if (stack < suspended_count())
+	{
+		frames = suspended_frames(Core::suspended_proc_list->buffer[Core::suspended_proc_list->front + stack]);
+	}
+	if (frame >= frames.size())
+	{
+		error = "no such frame";
+		return nullptr;
+	}
+	return frames[frame];
+}
+
+nlohmann::json DebugServer::get_stack_frame(std::int64_t stack, std::uint32_t frame)
+{
+	std::string error;
+	ExecutionContext* ctx = find_frame(stack, frame, error);
+	if (!ctx)
+	{
+		return { {"error", error} };
+	}
+	return frame_to_json(ctx);
+}
+
+nlohmann::json DebugServer::evaluate(std::int64_t stack, std::uint32_t frame, const std::vector<std::string>& paths)
+{
+	std::string error;
+	ExecutionContext* ctx = find_frame(stack, frame, error);
+	if (!ctx)
+	{
+		return { {"error", error} };
+	}
+	Core::Proc& proc = Core::get_proc(ctx);
+	std::unordered_map<std::string, std::uint32_t> ids;
+	std::vector<nlohmann::json> results;
+	results.reserve(paths.size());
+	for (const std::string& text : paths)
+	{
+		VarPath path;
+		Value value;
+		if (!VarPath::compile(proc, text, path, error, ids))
+		{
+			results.push_back({ {"error", error} });
+		}
+		else if (!path.read(ctx, value))
+		{
+			results.push_back({ {"error", "no such var or index"} });
+		}
+		else
+		{
+			results.push_back({ {"value", value_to_text(value)} });
+		}
+	}
+	return { {"results", results} };
 }
 
 void on_nop(ExecutionContext* ctx)
@@ -599,29 +1025,17 @@ void hRuntime(const char* error)
 
 
 
-/*trvh hGetVariable(int datumType, int datumId, unsigned int name_id)
-{
-	if (debug_server.data_breakpoints_read.find(datumType) != debug_server.data_breakpoints_read.end())
-	{
-		auto breakpoints_for_type = debug_server.data_breakpoints_read.at(datumType);
-		if (breakpoints_for_type.find(datumId) != breakpoints_for_type.end())
-		{
-			auto breakpoint_var_names = breakpoints_for_type.equal_range(datumId);
-			for (auto it = breakpoint_var_names.first; it != breakpoint_var_names.second; ++it)
-			{
-				if (it->second == name_id)
-				{
-					//debug_server.on_data_breakpoint(Core::get_context(), datumType, datumId, Core::GetStringFromId(name_id));
-				}
-			}
-		}
-	}
-	return oGetVariable(datumType, datumId, name_id);
-}*/
-
 extern "C" void on_singlestep()
 {
 	ExecutionContext* ctx = Core::get_context();
+	if (Profiler::opcode_counting_enabled)
+	{
+		Profiler::count_opcode(ctx);
+	}
+	if (Profiler::line_sample_pending.load(std::memory_order_relaxed))
+	{
+		Profiler::take_line_sample(ctx);
+	}
 	if (debug_server.breakpoint_to_restore && ctx->current_opcode != debug_server.breakpoint_to_restore->offset)
 	{
 		debug_server.restore_breakpoint();
@@ -644,6 +1058,7 @@ extern "C" void on_singlestep()
 		if (debug_server.step_over_sequence_number == UINT32_MAX)
 		{
 			debug_server.step_mode = StepMode::NONE;
+			debug_server.update_singlestep();
 			return;
 		}
 		if (ctx->bytecode[ctx->current_opcode] != BYTECODE_DBG_LINENO)
@@ -662,6 +1077,7 @@ extern "C" void on_singlestep()
 			debug_server.step_over_sequence_number = UINT32_MAX; //there is nothing to return to, we missed our chance
 			debug_server.step_over_parent_sequence_number = UINT32_MAX;
 			debug_server.step_mode = StepMode::NONE;
+			debug_server.update_singlestep();
 		}
 	}
 	else if (debug_server.step_mode == StepMode::PRE_OVER)
@@ -710,26 +1126,113 @@ CMP EDX, 0x143
 
 #define nth(x, n) (x >> (n * 8)) & 0xFF;
 
-void install_singlestep_hook()
-{
-	char* opcode_switch = (char*)Pocket::Sigscan::FindPattern("byondcore.dll", "0F B7 48 14 8B 78 10 8B F1 8B 14 B7 81 FA");
-	std::uint32_t addr = (std::uint32_t) & singlestep_hook;
+static char singlestep_original_bytes[7];
+static unsigned int singlestep_users = 0;
+static std::mutex singlestep_mutex;
 #ifdef _WIN32
+static char* singlestep_patch_site = nullptr;
+static DWORD game_thread_id = 0;
+static HANDLE game_thread = nullptr;
+
+static bool find_singlestep_patch_site()
+{
+	if (!singlestep_patch_site)
+	{
+		singlestep_patch_site = (char*)Pocket::Sigscan::FindPattern("byondcore.dll", "0F B7 48 14 8B 78 10 8B F1 8B 14 B7 81 FA");
+		if (singlestep_patch_site)
+		{
+			std::memcpy(singlestep_original_bytes, singlestep_patch_site, sizeof(singlestep_original_bytes));
+		}
+	}
+	return singlestep_patch_site;
+}
+
+static void write_code(char* dest, const char* src, std::size_t length)
+{
 	DWORD old_prot;
-	VirtualProtect((void*)opcode_switch, 16, PAGE_EXECUTE_READWRITE, &old_prot);
+	VirtualProtect((void*)dest, length, PAGE_EXECUTE_READWRITE, &old_prot);
+	std::memcpy(dest, src, length);
+	VirtualProtect((void*)dest, length, old_prot, &old_prot);
+	FlushInstructionCache(GetCurrentProcess(), dest, length);
+}
 #endif
-	opcode_switch[0] = 0xBA; //MOV EDX,
-	opcode_switch[1] = nth(addr, 0);
-	opcode_switch[2] = nth(addr, 1);
-	opcode_switch[3] = nth(addr, 2);
-	opcode_switch[4] = nth(addr, 3); //address of singlestep_hook
-	opcode_switch[5] = 0xFF; //CALL
-	opcode_switch[6] = 0xD2; //EDX
+
+// The patch replaces two instructions, so the game thread mustn't be between them, or in the middle of either,
+// when it changes. On the game thread itself we're never inside them, and returning from singlestep_hook lands
+// right after them, which is an instruction boundary either way.
+static void write_singlestep_patch(const char* bytes)
+{
 #ifdef _WIN32
-	VirtualProtect((void*)opcode_switch, 16, old_prot, &old_prot);
+	if (!game_thread || GetCurrentThreadId() == game_thread_id)
+	{
+		write_code(singlestep_patch_site, bytes, sizeof(singlestep_original_bytes));
+		return;
+	}
+	while (true)
+	{
+		SuspendThread(game_thread);
+		CONTEXT context;
+		context.ContextFlags = CONTEXT_CONTROL;
+		GetThreadContext(game_thread, &context);
+		char* ip = (char*)context.Eip;
+		if (ip <= singlestep_patch_site || ip >= singlestep_patch_site + sizeof(singlestep_original_bytes))
+		{
+			write_code(singlestep_patch_site, bytes, sizeof(singlestep_original_bytes));
+			ResumeThread(game_thread);
+			return;
+		}
+		ResumeThread(game_thread);
+		Sleep(0);
+	}
+#endif
+}
+
+bool singlestep_acquire()
+{
+#ifdef _WIN32
+	std::lock_guard<std::mutex> lk(singlestep_mutex);
+	if (singlestep_users > 0)
+	{
+		singlestep_users++;
+		return true;
+	}
+	if (!find_singlestep_patch_site())
+	{
+		return false;
+	}
+	singlestep_users = 1;
+	std::uint32_t addr = (std::uint32_t) & singlestep_hook;
+	char patch[7];
+	patch[0] = 0xBA; //MOV EDX,
+	patch[1] = nth(addr, 0);
+	patch[2] = nth(addr, 1);
+	patch[3] = nth(addr, 2);
+	patch[4] = nth(addr, 3); //address of singlestep_hook
+	patch[5] = 0xFF; //CALL
+	patch[6] = 0xD2; //EDX
+	write_singlestep_patch(patch);
+	return true;
+#else
+	return false;
 #endif
 }
 
+void singlestep_release()
+{
+	std::lock_guard<std::mutex> lk(singlestep_mutex);
+	if (singlestep_users == 0 || --singlestep_users > 0)
+	{
+		return;
+	}
+	write_singlestep_patch(singlestep_original_bytes);
+}
+
+bool singlestep_active()
+{
+	std::lock_guard<std::mutex> lk(singlestep_mutex);
+	return singlestep_users > 0;
+}
+
 bool debugger_initialize()
 {
 #ifdef _WIN32
@@ -740,9 +1243,16 @@ bool debugger_initialize()
 	}
 
 	oRuntime = Core::install_hook(Runtime, hRuntime);
-	install_singlestep_hook();
+	Profiler::locate_table(debug_server.profile_table);
+	// The singlestep hook is only patched in while something needs it. Scan for it now rather than mid-step.
+	find_singlestep_patch_site();
+	game_thread_id = GetCurrentThreadId();
+	game_thread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT, FALSE, game_thread_id);
+	debug_server.game_thread = std::this_thread::get_id();
 	breakpoint_opcode = Core::register_opcode("DEBUG_BREAKPOINT", on_breakpoint);
 	nop_opcode = Core::register_opcode("DEBUG_NOP", on_nop);
+	DataBreakpoints::initialize();
+	ProfileStream::initialize(); // also hooks ticks, which on_game_thread needs
 	debugger_initialized = true;
 	return true;
 #else
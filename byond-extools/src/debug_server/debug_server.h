@@ -2,10 +2,17 @@
 #include "../dmdism/instruction.h"
 #include "../core/socket/socket.h"
 #include "protocol.h"
+#include "breakpoint_condition.h"
+#include "logpoints.h"
+#include "send_queue.h"
+#include "../profiler/profiler.h"
 
+#include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <optional>
+#include <thread>
 
 const char* const DBG_MODE_NONE = "NONE";
 const char* const DBG_MODE_LAUNCHED = "LAUNCHED";
@@ -40,6 +47,11 @@ struct Breakpoint
 
 	bool one_shot;
 
+	// Null for breakpoints that always stop. Shared by the copies so they count hits together.
+	std::shared_ptr<BreakpointCondition> condition;
+	// Set for logpoints, which log instead of stopping.
+	std::shared_ptr<Logpoint> log;
+
 	bool operator==(const Breakpoint& rhs)
 	{
 		return proc == rhs.proc &&
@@ -67,21 +79,35 @@ struct BreakpointRestorer
 class DebugServer
 {
 	JsonStream debugger;
+	SendQueue outbox { debugger };
+	std::atomic<unsigned int> queued_jobs = 0; // by on_game_thread, still waiting for a tick
 public:
 	NextAction next_action = NextAction::WAIT;
 	StepMode step_mode = StepMode::NONE;
 	bool break_on_runtimes = false;
+	// Send frame summaries on a break and let the frontend fetch frames and suspended stacks as it needs them.
+	bool lazy_call_stacks = false;
+	// The stack the last "call stack" described. Only look at it while is_paused(): the game thread clears it
+	// some time after it was told to go on.
+	ExecutionContext* paused_context = nullptr;
+	bool paused = false; // guarded by notifier_mutex, see is_paused()
+	std::thread::id game_thread;
 	std::uint32_t step_over_sequence_number = UINT32_MAX;
 	std::uint32_t step_over_parent_sequence_number = UINT32_MAX;
 	std::optional<Breakpoint> breakpoint_to_restore = {};
 
 	std::unordered_map<int, std::unordered_map<int, Breakpoint>> breakpoints;
-	std::unordered_map<unsigned int, std::unordered_multimap<unsigned int, unsigned int>> data_breakpoints_read;
+	Profiler::DeltaTracker profile_tracker;
+	// Located by debugger_initialize on the main thread, so the debugger thread can take snapshots.
+	Profiler::Table profile_table;
 
-	void set_breakpoint(int proc_id, int offset, bool singleshot=false);
+	void set_breakpoint(int proc_id, int offset, bool singleshot=false, std::shared_ptr<BreakpointCondition> condition=nullptr, std::shared_ptr<Logpoint> log=nullptr);
 	std::optional<Breakpoint> get_breakpoint(int proc_id, int offset);
 	void remove_breakpoint(int proc_id, int offset);
 	void restore_breakpoint();
+	// Holds the singlestep hook only while stepping or putting a breakpoint back needs it.
+	void update_singlestep();
+	void step_past_breakpoint(ExecutionContext* ctx, Breakpoint bp, bool remove);
 
 	enum class HandleMessageResult;
 
@@ -92,18 +118,42 @@ public:
 	void debug_loop();
 
 	NextAction wait_for_action();
+	// Tells the game thread how to go on. From then on it isn't paused any more, even before it wakes up.
+	void continue_with(NextAction action);
+	// Whether the game thread is stopped at a break, from when its call stack is sent until continue_with().
+	// Frames and suspended procs can only be read while it is.
+	bool is_paused();
 
 	void on_error(ExecutionContext* ctx, const char* error);
 	void on_breakpoint(ExecutionContext* ctx);
 	void on_step(ExecutionContext* ctx, const char* reason = "step");
 	void on_break(ExecutionContext* ctx);
-	void on_data_breakpoint(ExecutionContext* ctx, unsigned int type, unsigned int value, std::string var_name);
-
-	void send_simple(std::string message_type);
-	void send(std::string message_type, nlohmann::json content);
+	// A watched var was written, or read if `old_value` is null, in which case `value` is what was read.
+	void on_data_breakpoint(ExecutionContext* ctx, Value datum, unsigned int name_id, const Value* old_value, Value value);
+
+	void send_simple(const char* message_type, Delivery delivery = Delivery::DROPPABLE);
+	void send(const char* message_type, nlohmann::json content, Delivery delivery = Delivery::DROPPABLE);
+	// Answers a request from the debugger, which is waiting for it.
+	void reply(nlohmann::json message);
+	// Runs `job` right away if BYOND can't be running procs meanwhile: on the game thread, or while it waits
+	// for the frontend. Otherwise it runs between the next two ticks. Jobs run in the order they were given.
+	void on_game_thread(std::function<void()> job);
 	void send_call_stacks(ExecutionContext* ctx);
+	nlohmann::json get_suspended_stacks(std::uint32_t start, std::uint32_t count);
+	nlohmann::json get_stack_frame(std::int64_t stack, std::uint32_t frame);
+	// Null with `error` set unless paused and the frame exists.
+	ExecutionContext* find_frame(std::int64_t stack, std::uint32_t frame, std::string& error);
+	// Reads every VarPath in `paths` in one frame, with var names shared between them.
+	nlohmann::json evaluate(std::int64_t stack, std::uint32_t frame, const std::vector<std::string>& paths);
 };
 
 
+// Patches the interpreter loop to call on_singlestep before every instruction. The patch is reference
+// counted and the original code is put back once every user has released it. Windows only.
+// Either can be called from any thread: off the game thread, the game thread is suspended somewhere outside the
+// patched instructions while they're rewritten.
+bool singlestep_acquire();
+void singlestep_release();
+bool singlestep_active();
 bool debugger_initialize();
 bool debugger_enable(const char* mode, const char* port);
@@ -1,6 +1,8 @@
 #include "../core/core.h"
 #include "debug_server.h"
 
+#include <chrono>
+
 extern "C" EXPORT const char* debug_initialize(int n_args, const char** args)
 {
 	// Fallback values if called
@@ -57,3 +59,50 @@ extern "C" EXPORT void force_debug()
 {
 	Core::initialize() && debugger_initialize() && debugger_enable(DBG_MODE_BACKGROUND, DBG_DEFAULT_PORT);
 }
+
+// Times a proc with the singlestep hook patched out and then in, to show what every instruction pays while
+// stepping or profiling. Arguments: proc path, number of calls (default 1000, at least 1). Returns nanoseconds per
+// call as JSON; "unpatched" is missing if something already holds the hook.
+extern "C" EXPORT const char* singlestep_overhead(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize() || n_args < 1)
+	{
+		return Core::FAIL;
+	}
+	Core::Proc* proc = Core::try_get_proc(args[0]);
+	if (!proc)
+	{
+		return Core::FAIL;
+	}
+	std::size_t calls = n_args > 1 ? std::strtoul(args[1], nullptr, 10) : 1000;
+	if (calls == 0)
+	{
+		return Core::FAIL;
+	}
+	auto time = [&] {
+		auto start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < calls; i++)
+		{
+			proc->call({});
+		}
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+	};
+	nlohmann::json out;
+	if (!singlestep_active())
+	{
+		out["unpatched"] = time();
+	}
+	if (!singlestep_acquire())
+	{
+		return Core::FAIL;
+	}
+	out["patched"] = time();
+	singlestep_release();
+	if (out.contains("unpatched") && out["unpatched"].get<double>() > 0)
+	{
+		out["overhead"] = out["patched"].get<double>() / out["unpatched"].get<double>() - 1;
+	}
+	result = out.dump();
+	return result.c_str();
+}
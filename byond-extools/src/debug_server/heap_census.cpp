@@ -0,0 +1,257 @@
+#include "heap_census.h"
+#include "debug_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+
+extern DebugServer debug_server;
+
+namespace
+{
+	enum class Phase
+	{
+		DATUMS,
+		OBJS,
+		MOBS,
+		LISTS,
+		DONE,
+	};
+
+	const std::uint32_t LIST_TYPE = 0xFFFFFFFF; // lists have no type of their own
+
+	struct Usage
+	{
+		std::uint64_t count = 0;
+		std::uint64_t bytes = 0;
+	};
+
+	struct Census
+	{
+		std::uint32_t id = 0;
+		std::chrono::steady_clock::time_point taken_at;
+		std::unordered_map<std::uint32_t, Usage> types;
+	};
+
+	// Only touched between ticks, on the main thread, apart from `running`.
+	std::atomic<bool> running = false;
+	std::uint32_t last_id = 0;
+	Phase phase;
+	std::uint32_t position;
+	std::chrono::microseconds budget;
+	std::size_t chunk_size;
+	Census current;
+	Census previous;
+	unsigned int type_string_id;
+
+	std::string type_name(std::uint32_t type)
+	{
+		if (type == LIST_TYPE)
+		{
+			return "/list";
+		}
+		Type* t = GetTypeById(type);
+		return t ? Core::GetStringFromId(t->path) : "/unknown";
+	}
+
+	void add(std::uint32_t type, std::size_t bytes)
+	{
+		Usage& usage = current.types[type];
+		usage.count++;
+		usage.bytes += bytes;
+	}
+
+	TableHolder2* table_of(Phase p)
+	{
+		switch (p)
+		{
+		case Phase::DATUMS: return Core::datum_table;
+		case Phase::OBJS: return Core::obj_table;
+		case Phase::MOBS: return Core::mob_table;
+		case Phase::LISTS: return Core::list_table;
+		default: return nullptr;
+		}
+	}
+
+	std::uint32_t table_length(Phase p)
+	{
+		if (p == Phase::DATUMS && !Core::datum_table)
+		{
+			// Some builds only have the datum pointer table, which holds the same datums.
+			return Core::datum_pointer_table ? *Core::datum_pointer_table_length : 0;
+		}
+		TableHolder2* table = table_of(p);
+		return table ? table->length : 0;
+	}
+
+	// Sizes count the structure and the buffers it owns that we know of, so they're a lower bound.
+	void visit(Phase p, std::uint32_t id)
+	{
+		if (p == Phase::DATUMS && !Core::datum_table)
+		{
+			if (RawDatum* datum = Core::GetDatumPointerById(id))
+			{
+				add(datum->type_id, sizeof(RawDatum) + datum->len_vars * sizeof(DatumVarEntry));
+			}
+			return;
+		}
+		void* element = table_of(p)->elements[id];
+		if (!element)
+		{
+			return;
+		}
+		switch (p)
+		{
+		case Phase::DATUMS: {
+			Datum* datum = (Datum*)element;
+			add(datum->type, sizeof(Datum) + datum->modified_vars_capacity * sizeof(VarListEntry));
+			break;
+		}
+		case Phase::OBJS: {
+			Obj* obj = (Obj*)element;
+			std::uint32_t type = GetVariable(DataType::OBJ, id, type_string_id).value;
+			add(type, sizeof(Obj) + obj->modified_vars_capacity * sizeof(VarListEntry));
+			break;
+		}
+		case Phase::MOBS: {
+			Mob* mob = (Mob*)element;
+			// A mob's type is a MOB_TYPEPATH, an index into the mob type table rather than a type id.
+			std::uint32_t type = *MobTableIndexToGlobalTableIndex(GetVariable(DataType::MOB, id, type_string_id).value);
+			add(type, sizeof(Mob) + mob->modified_vars_capacity * sizeof(VarListEntry));
+			break;
+		}
+		case Phase::LISTS: {
+			RawList* list = (RawList*)element;
+			std::size_t bytes = sizeof(RawList) + std::max(list->allocated_size, 0) * sizeof(Value);
+			if (list->map_part)
+			{
+				bytes += GetRBTreeMemoryUsage(list->map_part);
+			}
+			add(LIST_TYPE, bytes);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	void send_results()
+	{
+		struct Row
+		{
+			std::uint32_t type;
+			Usage now;
+			std::int64_t count_delta;
+			std::int64_t bytes_delta;
+		};
+		std::vector<Row> rows;
+		Usage totals;
+		for (const auto& [type, usage] : current.types)
+		{
+			auto before = previous.types.find(type);
+			Usage old = before == previous.types.end() ? Usage() : before->second;
+			rows.push_back({ type, usage, (std::int64_t)(usage.count - old.count), (std::int64_t)(usage.bytes - old.bytes) });
+			totals.count += usage.count;
+			totals.bytes += usage.bytes;
+		}
+		for (const auto& [type, usage] : previous.types)
+		{
+			if (!current.types.count(type))
+			{
+				rows.push_back({ type, Usage(), -(std::int64_t)usage.count, -(std::int64_t)usage.bytes });
+			}
+		}
+		std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+			if (a.bytes_delta != b.bytes_delta)
+			{
+				return a.bytes_delta > b.bytes_delta;
+			}
+			return a.count_delta > b.count_delta;
+		});
+
+		nlohmann::json since_previous = nullptr;
+		if (previous.id)
+		{
+			since_previous = std::chrono::duration<double>(current.taken_at - previous.taken_at).count();
+		}
+		std::size_t offset = 0;
+		do
+		{
+			std::size_t end = std::min(offset + chunk_size, rows.size());
+			std::vector<nlohmann::json> types;
+			types.reserve(end - offset);
+			for (std::size_t i = offset; i < end; i++)
+			{
+				const Row& row = rows[i];
+				types.push_back({
+					{ "type", type_name(row.type) },
+					{ "count", row.now.count },
+					{ "bytes", row.now.bytes },
+					{ "count_delta", row.count_delta },
+					{ "bytes_delta", row.bytes_delta },
+				});
+			}
+			nlohmann::json chunk = {
+				{ "census", current.id },
+				{ "previous", previous.id ? nlohmann::json(previous.id) : nlohmann::json(nullptr) },
+				{ "seconds_since_previous", since_previous },
+				{ "offset", offset },
+				{ "total_types", rows.size() },
+				{ "types", types },
+				{ "done", end == rows.size() },
+			};
+			if (end == rows.size())
+			{
+				chunk["totals"] = { { "count", totals.count }, { "bytes", totals.bytes } };
+			}
+			debug_server.send(MESSAGE_HEAP_CENSUS_CHUNK, std::move(chunk), Delivery::RELIABLE);
+			offset = end;
+		} while (offset < rows.size());
+	}
+
+	void step()
+	{
+		auto deadline = std::chrono::steady_clock::now() + budget;
+		std::uint32_t visited = 0;
+		while (phase != Phase::DONE)
+		{
+			if (position >= table_length(phase))
+			{
+				phase = (Phase)((int)phase + 1);
+				position = 0;
+				continue;
+			}
+			visit(phase, position++);
+			if (++visited % 256 == 0 && std::chrono::steady_clock::now() >= deadline)
+			{
+				Core::run_between_ticks(step);
+				return;
+			}
+		}
+		current.taken_at = std::chrono::steady_clock::now();
+		send_results();
+		previous = std::move(current);
+		running = false;
+	}
+}
+
+std::uint32_t HeapCensus::start(std::chrono::microseconds slice, std::size_t chunk, std::string& error)
+{
+	if (running.exchange(true))
+	{
+		error = "a census is already running";
+		return 0;
+	}
+	std::uint32_t id = ++last_id;
+	Core::run_between_ticks([=] {
+		type_string_id = Core::GetStringId("type");
+		phase = Phase::DATUMS;
+		position = 0;
+		budget = slice;
+		chunk_size = std::max<std::size_t>(chunk, 1);
+		current = Census();
+		current.id = id;
+		step();
+	});
+	return id;
+}
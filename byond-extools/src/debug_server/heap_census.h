@@ -0,0 +1,15 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Counts the objs, mobs, datums and lists alive on the server, with a rough size, by type. The tables are walked a
+// slice at a time between ticks, so even a big server only loses `budget` per tick while it runs. Each census is
+// compared with the one before it, and the result is sent to the debugger in "heap census chunk" messages with
+// the fastest growing types first.
+namespace HeapCensus
+{
+	// Returns the id of the new census, or 0 with `error` set if one is already running.
+	std::uint32_t start(std::chrono::microseconds budget, std::size_t chunk_size, std::string& error);
+}
@@ -0,0 +1,252 @@
+#include "logpoints.h"
+#include "debug_server.h"
+#include "../core/spsc_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+extern DebugServer debug_server;
+
+namespace
+{
+	const std::size_t MAX_VALUES = 8;
+	const std::size_t TEXT_LENGTH = 56;
+
+	struct CapturedValue
+	{
+		DataType type;
+		bool missing;
+		bool truncated;
+		std::uint32_t value;
+		char text[TEXT_LENGTH]; // strings are copied, they may be gone by the time the hit is formatted
+	};
+
+	struct Hit
+	{
+		std::uint32_t logpoint;
+		std::uint32_t count;
+		std::int64_t time; // milliseconds since the epoch
+		CapturedValue values[MAX_VALUES];
+	};
+
+	// Everything the drain thread needs to format a hit, so it never has to touch BYOND.
+	struct Format
+	{
+		std::string proc;
+		unsigned int override_id;
+		std::uint16_t offset;
+		std::vector<std::string> pieces; // text around the expressions, one more than there are of them
+	};
+
+	Core::SpscRing<Hit, 1024> ring;
+	std::atomic<std::uint64_t> dropped = 0;
+
+	std::mutex mutex; // guards everything below
+	std::unordered_map<std::uint32_t, Format> formats;
+	std::uint32_t next_id = 0;
+	std::ofstream file;
+	bool drain_started = false;
+
+	std::string value_text(const CapturedValue& value)
+	{
+		if (value.missing)
+		{
+			return "?";
+		}
+		switch (value.type)
+		{
+		case DataType::NULL_D:
+			return "null";
+		case DataType::NUMBER:
+		{
+			float f;
+			std::memcpy(&f, &value.value, sizeof(f));
+			std::ostringstream out;
+			out << f;
+			return out.str();
+		}
+		case DataType::STRING:
+			return std::string(value.text) + (value.truncated ? "..." : "");
+		default:
+		{
+			// The same as \ref
+			std::ostringstream out;
+			out << "[0x" << std::hex << (((std::uint32_t)value.type << 24) | value.value) << "]";
+			return out.str();
+		}
+		}
+	}
+
+	nlohmann::json value_literal(const CapturedValue& value)
+	{
+		if (value.missing || value.type == DataType::NULL_D)
+		{
+			return { { "ref", 0 } };
+		}
+		if (value.type == DataType::NUMBER)
+		{
+			float f;
+			std::memcpy(&f, &value.value, sizeof(f));
+			return { { "number", f } };
+		}
+		if (value.type == DataType::STRING)
+		{
+			return { { "string", value_text(value) } };
+		}
+		return { { "ref", ((std::uint32_t)value.type << 24) | value.value } };
+	}
+
+	void drain()
+	{
+		while (true)
+		{
+			std::vector<nlohmann::json> batch;
+			{
+				std::lock_guard<std::mutex> lk(mutex);
+				for (const Hit* hit = ring.front(); hit && batch.size() < 256; ring.pop(), hit = ring.front())
+				{
+					auto ptr = formats.find(hit->logpoint);
+					if (ptr == formats.end())
+					{
+						continue; // removed since
+					}
+					const Format& format = ptr->second;
+					std::string message = format.pieces[0];
+					std::vector<nlohmann::json> values;
+					for (std::uint32_t i = 0; i < hit->count; i++)
+					{
+						message += value_text(hit->values[i]) + format.pieces[i + 1];
+						values.push_back({ { "literal", value_literal(hit->values[i]) } });
+					}
+					if (file.is_open())
+					{
+						file << hit->time << " " << format.proc << ":" << format.offset << " " << message << "\n";
+					}
+					batch.push_back({
+						{ "proc", format.proc },
+						{ "override_id", format.override_id },
+						{ "offset", format.offset },
+						{ "time", hit->time },
+						{ "message", message },
+						{ "values", values },
+					});
+				}
+				if (file.is_open() && !batch.empty())
+				{
+					file.flush();
+				}
+			}
+			if (batch.empty())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				continue;
+			}
+			debug_server.send(MESSAGE_LOGPOINT_OUTPUT, { { "hits", batch }, { "dropped", dropped.exchange(0) } }, Delivery::COALESCE);
+		}
+	}
+}
+
+std::shared_ptr<Logpoint> Logpoint::compile(Core::Proc& proc, std::uint16_t offset, const std::string& message, std::string& error)
+{
+	auto result = std::make_shared<Logpoint>();
+	Format format { proc.name, proc.override_id, offset, { "" } };
+	for (std::size_t i = 0; i < message.size(); i++)
+	{
+		if ((message[i] == '{' || message[i] == '}') && i + 1 < message.size() && message[i + 1] == message[i])
+		{
+			format.pieces.back().push_back(message[i++]);
+			continue;
+		}
+		if (message[i] != '{')
+		{
+			format.pieces.back().push_back(message[i]);
+			continue;
+		}
+		std::size_t close = message.find('}', i);
+		if (close == std::string::npos)
+		{
+			error = "unclosed { at " + std::to_string(i);
+			return nullptr;
+		}
+		if (result->expressions.size() == MAX_VALUES)
+		{
+			error = "a log message can have at most " + std::to_string(MAX_VALUES) + " expressions";
+			return nullptr;
+		}
+		VarPath path;
+		if (!VarPath::compile(proc, message.substr(i + 1, close - i - 1), path, error))
+		{
+			return nullptr;
+		}
+		result->expressions.push_back(std::move(path));
+		format.pieces.emplace_back();
+		i = close;
+	}
+
+	std::lock_guard<std::mutex> lk(mutex);
+	result->id = next_id++;
+	formats[result->id] = std::move(format);
+	if (!drain_started)
+	{
+		std::thread(drain).detach();
+		drain_started = true;
+	}
+	return result;
+}
+
+Logpoint::~Logpoint()
+{
+	std::lock_guard<std::mutex> lk(mutex);
+	formats.erase(id);
+}
+
+void Logpoint::hit(ExecutionContext* ctx)
+{
+	Hit* entry = ring.claim();
+	if (!entry)
+	{
+		dropped++;
+		return;
+	}
+	entry->logpoint = id;
+	entry->count = expressions.size();
+	entry->time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	for (std::size_t i = 0; i < expressions.size(); i++)
+	{
+		CapturedValue& captured = entry->values[i];
+		Value value;
+		captured.missing = !expressions[i].read(ctx, value);
+		captured.type = value.type;
+		captured.value = value.value;
+		captured.truncated = false;
+		captured.text[0] = 0;
+		if (!captured.missing && value.type == DataType::STRING)
+		{
+			const char* text = GetStringTableEntry(value.value)->stringData;
+			std::size_t length = std::strlen(text);
+			captured.truncated = length >= TEXT_LENGTH;
+			length = std::min(length, TEXT_LENGTH - 1);
+			std::memcpy(captured.text, text, length);
+			captured.text[length] = 0;
+		}
+	}
+	ring.commit();
+}
+
+bool Logpoints::set_file(const std::string& path)
+{
+	std::lock_guard<std::mutex> lk(mutex);
+	file.close();
+	if (path.empty())
+	{
+		return true;
+	}
+	file.open(path, std::ios::app);
+	return file.is_open();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "breakpoint_condition.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// A breakpoint that never pauses. Each hit captures the values of the {expressions} in its message into a ring
+// buffer, and a background thread formats them and sends them to the debugger and, if set, a log file. If the
+// ring fills up faster than it drains, hits are dropped and counted rather than slowing the game down.
+//
+//	"hit {i} times, src is {src.name}"
+class Logpoint
+{
+public:
+	// Expressions are VarPaths. Use {{ and }} for literal braces.
+	static std::shared_ptr<Logpoint> compile(Core::Proc& proc, std::uint16_t offset, const std::string& message, std::string& error);
+	~Logpoint();
+
+	// Game thread only.
+	void hit(ExecutionContext* ctx);
+
+private:
+	std::uint32_t id;
+	std::vector<VarPath> expressions;
+};
+
+namespace Logpoints
+{
+	// Appends output to `path` as well, or stops if it's empty. Returns false if the file can't be opened.
+	bool set_file(const std::string& path);
+}
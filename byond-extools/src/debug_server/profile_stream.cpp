@@ -0,0 +1,108 @@
+#include "profile_stream.h"
+#include "debug_server.h"
+#include "../tffi/tffi.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+extern DebugServer debug_server;
+
+namespace
+{
+	std::atomic<std::uint64_t> maptick_count = 0;
+	std::atomic<std::uint64_t> maptick_nanoseconds = 0;
+
+	struct Subscription
+	{
+		Profiler::Table table;
+		std::chrono::milliseconds interval;
+		std::size_t count;
+		Profiler::SortKey key;
+		std::uint64_t generation;
+	};
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::optional<Subscription> subscription;
+	std::uint64_t generation = 0;
+	bool thread_running = false;
+
+	void stream_loop()
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		std::uint64_t current = 0;
+		Profiler::DeltaTracker tracker;
+		std::uint64_t last_maptick_count = 0;
+		std::uint64_t last_maptick_nanoseconds = 0;
+		while (true)
+		{
+			changed.wait(lk, [] { return subscription.has_value(); });
+			Subscription sub = *subscription;
+			if (sub.generation != current)
+			{
+				current = sub.generation;
+				lk.unlock();
+				tracker.reset();
+				tracker.advance(sub.table, sub.key, 0);
+				last_maptick_count = maptick_count;
+				last_maptick_nanoseconds = maptick_nanoseconds;
+				lk.lock();
+			}
+			if (changed.wait_for(lk, sub.interval, [&] { return !subscription || subscription->generation != current; }))
+			{
+				continue;
+			}
+			lk.unlock();
+
+			std::vector<Profiler::Delta> deltas = tracker.advance(sub.table, sub.key, sub.count);
+			std::vector<nlohmann::json> procs;
+			procs.reserve(deltas.size());
+			for (const Profiler::Delta& d : deltas)
+			{
+				// Ids index "proc list" and times are in microseconds, to keep updates small.
+				procs.push_back({ d.proc_id, d.call_count, d.self, d.total });
+			}
+			std::uint64_t ticks = maptick_count;
+			std::uint64_t nanoseconds = maptick_nanoseconds;
+			debug_server.send(MESSAGE_PROFILE_UPDATE, {
+				{ "interval", tracker.seconds_since_last() },
+				{ "procs", procs },
+				{ "maptick", { { "count", ticks - last_maptick_count }, { "microseconds", (nanoseconds - last_maptick_nanoseconds) / 1000 } } },
+				{ "tffi_in_flight", TFFI::calls_in_flight() },
+			}, Delivery::DROPPABLE);
+			last_maptick_count = ticks;
+			last_maptick_nanoseconds = nanoseconds;
+
+			lk.lock();
+		}
+	}
+}
+
+bool ProfileStream::initialize()
+{
+	return Core::on_maptick([](std::chrono::nanoseconds duration) {
+		maptick_count.fetch_add(1, std::memory_order_relaxed);
+		maptick_nanoseconds.fetch_add(duration.count(), std::memory_order_relaxed);
+	});
+}
+
+void ProfileStream::subscribe(const Profiler::Table& table, std::chrono::milliseconds interval, std::size_t count, Profiler::SortKey key)
+{
+	std::lock_guard<std::mutex> lk(mutex);
+	subscription = Subscription { table, interval, count, key, ++generation };
+	if (!thread_running)
+	{
+		thread_running = true;
+		std::thread(stream_loop).detach();
+	}
+	changed.notify_all();
+}
+
+void ProfileStream::unsubscribe()
+{
+	std::lock_guard<std::mutex> lk(mutex);
+	subscription.reset();
+	changed.notify_all();
+}
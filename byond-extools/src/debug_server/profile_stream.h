@@ -0,0 +1,16 @@
+#pragma once
+
+#include "../profiler/profiler.h"
+
+// Pushes a "profile update" to the debugger every interval, so a frontend can show a live profile without
+// asking for each proc. Updates are built on a background thread from ProfileInfo snapshots; all the game thread
+// does is time SendMaps. The background thread only copies the table, it never calls into BYOND.
+namespace ProfileStream
+{
+	// Starts timing maptick. Call from the main thread.
+	bool initialize();
+	// Replaces the current subscription, if any. The first update covers the time since this call. `table` has to
+	// have been located on the main thread, see Profiler::Table.
+	void subscribe(const Profiler::Table& table, std::chrono::milliseconds interval, std::size_t count, Profiler::SortKey key);
+	void unsubscribe();
+}
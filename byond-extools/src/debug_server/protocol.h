@@ -2,6 +2,8 @@
 
 // The Extools debugger protocol consists of a null-separarated stream of JSON
 // blobs. Each blob is a `Message` struct as described in `protocol.ts`.
+// A frontend can switch to length-prefixed MessagePack or CBOR with a
+// "framing" message.
 
 // See `MessageDeclarations` in `protocol.ts` for the request-response
 // structure of these message types.
@@ -27,9 +29,19 @@
 #define MESSAGE_TOGGLE_PROFILER "toggle profiler"
 #define MESSAGE_GET_LIST_CONTENTS "get list contents"
 #define MESSAGE_GET_PROFILE "get profile"
+#define MESSAGE_GET_PROFILE_DELTA "get profile delta"
 #define MESSAGE_GET_SOURCE "get source"
 #define MESSAGE_DATA_BREAKPOINT_SET "data breakpoint set"
 #define MESSAGE_DATA_BREAKPOINT_UNSET "data breakpoint unset"
+#define MESSAGE_XREF "xref"
+#define MESSAGE_FRAMING "framing"
+#define MESSAGE_LAZY_CALL_STACKS "lazy call stacks"
+#define MESSAGE_GET_SUSPENDED_STACKS "get suspended stacks"
+#define MESSAGE_GET_STACK_FRAME "get stack frame"
+#define MESSAGE_EVALUATE "evaluate"
+#define MESSAGE_LOGPOINT_FILE "logpoint file"
+#define MESSAGE_PROFILE_SUBSCRIBE "profile subscribe"
+#define MESSAGE_HEAP_CENSUS "heap census"
 
 // response only
 #define MESSAGE_BREAKPOINT_HIT "breakpoint hit"
@@ -37,3 +49,8 @@
 #define MESSAGE_DATA_BREAKPOINT_WRITE "data breakpoint write"
 #define MESSAGE_CALL_STACK "call stack"
 #define MESSAGE_RUNTIME "runtime"
+#define MESSAGE_LOGPOINT_OUTPUT "logpoint output"
+#define MESSAGE_PROFILE_UPDATE "profile update"
+#define MESSAGE_HEAP_CENSUS_CHUNK "heap census chunk"
+#define MESSAGE_MESSAGES_DROPPED "messages dropped"
+#define MESSAGE_PROTOCOL_ERROR "protocol error"
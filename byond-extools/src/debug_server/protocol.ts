@@ -35,6 +35,24 @@ interface StackFrame extends ProcOffset {
     dot: Value,
     locals: Value[],
     args: Value[],
+    local_names: string[],
+    arg_names: string[],
+}
+
+interface SuspendedStack {
+    // Pass to "get stack frame". Only valid until the game resumes.
+    id: number,
+    // Innermost frame first.
+    frames: ProcOffset[],
+}
+
+interface LogpointHit extends ProcOffset {
+    // Milliseconds since the Unix epoch.
+    time: number,
+    message: string,
+    // The values in the message, in order. Strings are cut short, and refs may be stale by the time this
+    // arrives.
+    values: Value[],
 }
 
 interface Runtime extends ProcOffset {
@@ -48,9 +66,13 @@ interface BreakpointHit extends ProcOffset {
 interface ReadBreakpointHit {
     ref: Ref,
     field_name: string,
+    value: Value,
 }
 
-interface WriteBreakpointHit extends ReadBreakpointHit {
+interface WriteBreakpointHit {
+    ref: Ref,
+    field_name: string,
+    old_value: Value,
     new_value: Value,
 }
 
@@ -70,6 +92,65 @@ interface ProfileEntry extends ProcId {
     call_count: number,
 }
 
+interface ProfileDelta {
+    // Seconds elapsed since the previous "get profile delta", 0 on the first request.
+    interval: number,
+    // Procs that ran since the previous request, sorted by the requested key.
+    procs: ProfileEntry[],
+}
+
+interface ProfileUpdate {
+    // Seconds covered by this update.
+    interval: number,
+    // [proc id, calls, self microseconds, total microseconds], sorted by the subscribed key. The id is the
+    // index of the proc in "proc list".
+    procs: [number, number, number, number][],
+    // Ticks sent during the interval, and the time SendMaps took for them.
+    maptick: {
+        count: number,
+        microseconds: number,
+    },
+    // Calls made with call_async that haven't returned to DM yet.
+    tffi_in_flight: number,
+}
+
+interface HeapCensusRow {
+    // A type path, or "/list" for every list.
+    type: string,
+    count: number,
+    // A lower bound: the object itself and the buffers extools knows it owns.
+    bytes: number,
+    // Change since the previous census, or the full amounts in the first one.
+    count_delta: number,
+    bytes_delta: number,
+}
+
+interface HeapCensusChunk {
+    census: number,
+    previous: number | null,
+    seconds_since_previous: number | null,
+    // Position of `types[0]` among all the rows, which are sorted by bytes_delta, biggest growth first.
+    offset: number,
+    total_types: number,
+    types: HeapCensusRow[],
+    done: boolean,
+    // On the last chunk.
+    totals?: {
+        count: number,
+        bytes: number,
+    },
+}
+
+// ----------------------------------------------------------------------------
+// Cross-reference index
+
+interface XrefReference extends ProcOffset {
+    // False if the target is only known by name, like a call on an object of unknown type.
+    exact: boolean,
+    // Only for "strings" queries: the literal that matched.
+    string?: string,
+}
+
 // ----------------------------------------------------------------------------
 // BYOND value types
 
@@ -127,13 +208,47 @@ interface MessageDeclarations {
         response: DisassembledProc,
     },
     "breakpoint set": {
-        request: ProcOffset,
-        response: ProcOffset,
+        // Setting an existing breakpoint replaces its condition and resets its hit count.
+        request: ProcOffset & {
+            // Checked by extools, e.g. `i > 10 && src.name == "bob"`. Clauses are joined with &&, and each is
+            // a variable, optionally compared to a number, "string" or null. Variables are a local or argument,
+            // src, usr or global, followed by any number of .var lookups.
+            condition?: string,
+            // "N" or ">= N" stops from the Nth matching hit on, "== N" only on the Nth, "% N" on every Nth.
+            hit_condition?: string,
+            // Makes this a logpoint, which never pauses and sends "logpoint output" instead. Variables in
+            // braces are filled in, e.g. "i is {i}". Use {{ and }} for literal braces. At most 8 variables.
+            log_message?: string,
+            // Removes the breakpoint the first time it stops or logs.
+            one_shot?: boolean,
+        },
+        // With `error` set if the condition didn't compile, in which case nothing was set.
+        response: ProcOffset & { error?: string },
     },
     "breakpoint unset": {
         request: ProcOffset,
         response: ProcOffset,
     },
+    "data breakpoint set": {
+        // Pauses when the field is written, read, or either. Defaults to 'write'.
+        request: {
+            ref: Ref,
+            field_name: string,
+            access?: 'write' | 'read' | 'readWrite',
+        },
+        response: {
+            error?: string,
+        },
+    },
+    "data breakpoint unset": {
+        request: {
+            ref: Ref,
+            field_name: string,
+        },
+        response: {
+            error?: string,
+        },
+    },
     "breakpoint step into": {
         request: {},
     },
@@ -181,6 +296,40 @@ interface MessageDeclarations {
         request: ProcId,
         response: ProfileEntry,
     },
+    "get profile delta": {
+        request: {
+            sort?: 'self' | 'total' | 'real' | 'overtime' | 'calls',
+            count?: number,
+        },
+        response: ProfileDelta,
+    },
+    "profile subscribe": {
+        // Starts pushing "profile update" every interval_ms (at least 50), or stops if null. Profiling
+        // has to be on, see "toggle profiler".
+        request: {
+            interval_ms?: number,
+            count?: number,
+            sort?: 'self' | 'total' | 'real' | 'overtime' | 'calls',
+        } | null,
+        // The settings in effect, or null once unsubscribed.
+        response: {
+            interval_ms: number,
+            count: number,
+            sort: string,
+        } | null,
+    },
+    "heap census": {
+        // Counts objs, mobs, datums and lists by type, spending at most budget_us (default 1000) of each tick
+        // on it. Results arrive as "heap census chunk" messages, chunk_size rows (default 500) at a time.
+        request: {
+            budget_us?: number,
+            chunk_size?: number,
+        },
+        response: {
+            census?: number,
+            error?: string,
+        },
+    },
     "toggle profiler": {
         request: boolean,
         response: boolean,
@@ -189,6 +338,73 @@ interface MessageDeclarations {
         request: 'stddef.dm',
         response: string,
     },
+    "xref": {
+        // Needs xref_build() to have been called from DM.
+        request: {
+            kind: 'callers' | 'callees' | 'readers' | 'writers' | 'strings',
+            // A proc path, a var name or "/type/var/name", or text to search string literals for.
+            subject: string,
+        },
+        response: {
+            kind: string,
+            subject: string,
+            references?: XrefReference[],
+            error?: string,
+        },
+    },
+    "logpoint file": {
+        // Also appends logpoint output to this file, or stops if empty. The response is empty if it couldn't
+        // be opened.
+        request: string,
+        response: string,
+    },
+    "lazy call stacks": {
+        // If true, "call stack" only has frame summaries and the rest is fetched on demand.
+        request: boolean,
+        response: boolean,
+    },
+    "get suspended stacks": {
+        // Only while paused. Defaults to the first 50.
+        request: {
+            start?: number,
+            count?: number,
+        },
+        response: {
+            total: number,
+            stacks: SuspendedStack[],
+        } | { error: string },
+    },
+    "get stack frame": {
+        // Only while paused. Frames count from the innermost one.
+        request: {
+            // A SuspendedStack id, or omitted for the stack that hit the break.
+            stack?: number,
+            frame: number,
+        },
+        response: StackFrame | { error: string },
+    },
+    "evaluate": {
+        // Only while paused. Reads each path in one frame, like src.loc.contents[3].name, L["key"] or
+        // global.round_id: a local, argument, src, usr or global, then .var, [index] or ["key"] steps.
+        request: {
+            // As for "get stack frame", the frame that hit the break by default.
+            stack?: number,
+            frame?: number,
+            paths: string[],
+        },
+        // One result per path, in order.
+        response: {
+            results: ({ value: Value } | { error: string })[],
+        } | { error: string },
+    },
+    "framing": {
+        // Switches how messages are framed. Unknown names keep the current framing, so check the response,
+        // which is sent in the old framing. Every message after it, in both directions, uses the new one, so
+        // don't send anything else until it arrives. Send this before "configuration done", while the game is
+        // still waiting on the frontend. Binary framings are a 4-byte big-endian payload length, then the payload.
+        request: 'json' | 'msgpack' | 'cbor',
+        response: 'json' | 'msgpack' | 'cbor',
+    },
     // response only
     "breakpoint hit": {
         response: BreakpointHit,
@@ -203,9 +419,35 @@ interface MessageDeclarations {
         response: {
             "current": StackFrame[],
             "suspended": StackFrame[][],
+        } | {
+            // With "lazy call stacks" on.
+            "current": ProcOffset[],
+            "suspended_count": number,
         },
     },
     "runtime": {
         response: Runtime,
     },
+    "logpoint output": {
+        response: {
+            hits: LogpointHit[],
+            // Hits lost since the previous batch because they came faster than they could be sent.
+            dropped: number,
+        },
+    },
+    "heap census chunk": {
+        response: HeapCensusChunk,
+    },
+    "profile update": {
+        // Updates are dropped rather than queued when the frontend falls behind.
+        response: ProfileUpdate,
+    },
+    "messages dropped": {
+        // Sent once the outbound queue drains after it overflowed. Counts by message type.
+        response: { [type: string]: number },
+    },
+    "protocol error": {
+        // A message couldn't be parsed or handled.
+        response: string,
+    },
 }
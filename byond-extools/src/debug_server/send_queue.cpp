@@ -0,0 +1,105 @@
+#include "send_queue.h"
+#include "protocol.h"
+
+#include <thread>
+
+static void merge(nlohmann::json& into, nlohmann::json& from)
+{
+	if (!into.is_object() || !from.is_object())
+	{
+		into = std::move(from);
+		return;
+	}
+	for (auto& [key, value] : from.items())
+	{
+		nlohmann::json& existing = into[key];
+		if (existing.is_array() && value.is_array())
+		{
+			for (nlohmann::json& element : value)
+			{
+				existing.push_back(std::move(element));
+			}
+		}
+		else if (existing.is_number_integer() && value.is_number_integer())
+		{
+			existing = existing.get<std::int64_t>() + value.get<std::int64_t>();
+		}
+		else
+		{
+			existing = std::move(value);
+		}
+	}
+}
+
+void SendQueue::push(const char* type, nlohmann::json message, Delivery delivery)
+{
+	std::unique_lock<std::mutex> lk(mutex);
+	if (!writing)
+	{
+		writing = true;
+		std::thread(&SendQueue::write_loop, this).detach();
+	}
+	if (delivery == Delivery::LATEST || delivery == Delivery::COALESCE)
+	{
+		for (Entry& entry : queue)
+		{
+			if (entry.delivery == delivery && entry.type == type)
+			{
+				if (delivery == Delivery::LATEST)
+				{
+					entry.message = std::move(message);
+				}
+				else
+				{
+					merge(entry.message["content"], message["content"]);
+				}
+				return;
+			}
+		}
+	}
+	if (queue.size() >= limit && delivery != Delivery::RELIABLE && delivery != Delivery::BLOCKING)
+	{
+		dropped[type]++;
+		return;
+	}
+	std::uint64_t sequence = ++last_pushed;
+	queue.push_back({ type, std::move(message), framing, delivery, sequence });
+	pushed.notify_one();
+	if (delivery == Delivery::BLOCKING)
+	{
+		written.wait(lk, [&] { return last_written >= sequence; });
+	}
+}
+
+void SendQueue::set_framing(Framing new_framing)
+{
+	std::lock_guard<std::mutex> lk(mutex);
+	framing = new_framing;
+}
+
+void SendQueue::write_loop()
+{
+	std::unique_lock<std::mutex> lk(mutex);
+	while (true)
+	{
+		pushed.wait(lk, [this] { return !queue.empty() || !dropped.empty(); });
+		if (queue.empty())
+		{
+			nlohmann::json counts(dropped);
+			dropped.clear();
+			Framing current = framing;
+			lk.unlock();
+			stream.send({ { "type", MESSAGE_MESSAGES_DROPPED }, { "content", std::move(counts) } }, current);
+			lk.lock();
+			continue;
+		}
+		Entry entry = std::move(queue.front());
+		queue.pop_front();
+		lk.unlock();
+		// If the client is gone this fails straight away, which still lets blocked senders go.
+		stream.send(entry.message, entry.framing);
+		lk.lock();
+		last_written = entry.sequence;
+		written.notify_all();
+	}
+}
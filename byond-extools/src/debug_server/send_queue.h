@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../core/socket/socket.h"
+#include "../third_party/json.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+enum class Delivery
+{
+	DROPPABLE, // dropped and counted if the queue is full
+	LATEST, // replaces an unsent message of the same type
+	COALESCE, // merged into an unsent message of the same type: arrays are appended and numbers added
+	RELIABLE, // never dropped
+	BLOCKING, // never dropped, and the sender waits until it's been written
+};
+
+// Messages to the debugger, written by a thread of its own so a slow client doesn't hold up the game. Only the
+// messages that stop the game anyway should be BLOCKING. Drops are reported with a "messages dropped" message
+// once the queue has drained.
+class SendQueue
+{
+public:
+	explicit SendQueue(JsonStream& stream) : stream(stream) {}
+
+	void push(const char* type, nlohmann::json message, Delivery delivery);
+	// Messages pushed from now on are written with `new_framing`. The stream's own framing is only for receiving,
+	// since it's switched on the reading thread while others are pushing.
+	void set_framing(Framing new_framing);
+
+	// Messages past this many are dropped, unless they're RELIABLE or BLOCKING.
+	std::size_t limit = 1024;
+
+private:
+	struct Entry
+	{
+		std::string type;
+		nlohmann::json message;
+		Framing framing; // what was set when it was queued, so a switch takes effect in order
+		Delivery delivery;
+		std::uint64_t sequence;
+	};
+
+	void write_loop();
+
+	JsonStream& stream;
+	std::mutex mutex;
+	std::condition_variable pushed;
+	std::condition_variable written;
+	std::deque<Entry> queue;
+	std::map<std::string, std::uint64_t> dropped;
+	Framing framing = Framing::JSON;
+	std::uint64_t last_pushed = 0;
+	std::uint64_t last_written = 0;
+	bool writing = false;
+};
@@ -0,0 +1,80 @@
+#include "assembler.h"
+#include "instruction.h"
+
+static const std::uint32_t UNBOUND = 0xFFFFFFFF;
+
+Label Assembler::label()
+{
+	labels.push_back(UNBOUND);
+	return { (std::uint32_t)labels.size() - 1 };
+}
+
+Assembler& Assembler::bind(Label label)
+{
+	labels.at(label.id) = offset();
+	return *this;
+}
+
+Assembler& Assembler::word(Label target)
+{
+	relocations.push_back({ offset(), target.id });
+	out.push_back(0);
+	return *this;
+}
+
+Assembler& Assembler::instruction(Instruction& instr, const Label* targets)
+{
+	std::vector<std::uint32_t>& bytes = instr.bytes();
+	std::size_t start = out.size();
+	out.insert(out.end(), bytes.begin(), bytes.end());
+	if (targets)
+	{
+		for (std::size_t i = 0; i < instr.jump_locations().size(); i++)
+		{
+			relocations.push_back({ (std::uint32_t)(start + instr.jump_operand(i)), targets[i].id });
+		}
+	}
+	return *this;
+}
+
+Assembler& Assembler::instruction(BytecodeView code, const DecodedProc& decoded, std::size_t i, const Label* targets)
+{
+	const DecodedInstruction& instr = decoded.instructions[i];
+	std::size_t start = out.size();
+	out.insert(out.end(), code.begin() + instr.offset, code.begin() + instr.offset + instr.length);
+	if (targets)
+	{
+		for (std::size_t j = 0; j < instr.jump_count; j++)
+		{
+			relocations.push_back({ (std::uint32_t)(start + decoded.jump_operands[instr.first_jump + j] - instr.offset), targets[j].id });
+		}
+	}
+	return *this;
+}
+
+bool Assembler::finish(std::string& error)
+{
+	if (out.size() > 0xFFFF)
+	{
+		error = "bytecode is " + std::to_string(out.size()) + " words long, jumps only reach 65535";
+		return false;
+	}
+	for (const Relocation& relocation : relocations)
+	{
+		std::uint32_t target = labels.at(relocation.label);
+		if (target == UNBOUND)
+		{
+			error = "label " + std::to_string(relocation.label) + " is used at " + std::to_string(relocation.position) + " but never bound";
+			return false;
+		}
+		out[relocation.position] = target;
+	}
+	relocations.clear();
+	return true;
+}
+
+bool Assembler::finish()
+{
+	std::string error;
+	return finish(error);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "decoder.h"
+#include "opcodes_enum.h"
+
+#include <string>
+#include <vector>
+
+class Instruction;
+
+// A jump target that may not have an offset yet.
+struct Label
+{
+	std::uint32_t id;
+};
+
+// Builds bytecode with symbolic jump targets. Each word is written straight into the output as it is emitted,
+// jump operands as a placeholder, and finish() patches them once every label has an offset. Jumps can go
+// forwards or backwards, and switch and pick_switch tables relocate the same way as plain jumps.
+//
+//	std::vector<std::uint32_t> code;
+//	Assembler a(code);
+//	Label loop = a.label(), done = a.label();
+//	a.bind(loop).GETVAR(AccessModifier::LOCAL, 0).JZ(done);
+//	...
+//	a.JMP(loop).bind(done).END();
+//	a.finish(error);
+class Assembler
+{
+public:
+	// Offsets are positions in `out`, which normally starts empty. Reserve it first to avoid reallocating.
+	explicit Assembler(std::vector<std::uint32_t>& out) : out(out) {}
+
+	Label label();
+	// Makes `label` refer to wherever the next word goes.
+	Assembler& bind(Label label);
+	std::uint32_t offset() const { return out.size(); }
+
+	Assembler& word(std::uint32_t value) { out.push_back(value); return *this; }
+	Assembler& word(AccessModifier value) { return word((std::uint32_t)value); }
+	Assembler& word(Label target); // a jump operand
+
+	// An opcode followed by its operands, each a word, an access modifier or a Label for jump operands.
+	template<typename... Operands>
+	Assembler& emit(Bytecode opcode, Operands... operands)
+	{
+		word((std::uint32_t)opcode);
+		(word(operands), ...);
+		return *this;
+	}
+
+	// One helper per opcode, so a.JZ(done) is a.emit(Bytecode::JZ, done).
+#define I(NUMBER, NAME, DIS) \
+	template<typename... Operands> \
+	Assembler& NAME(Operands... operands) { return emit(Bytecode::NAME, operands...); }
+#include "opcodes_table.inl"
+#undef I
+
+	// Copies an existing instruction. If `targets` is given, its i-th jump goes to targets[i] instead.
+	Assembler& instruction(Instruction& instr, const Label* targets = nullptr);
+	Assembler& instruction(BytecodeView code, const DecodedProc& decoded, std::size_t i, const Label* targets = nullptr);
+
+	// Writes the offset of every label into the jump operands that refer to it. Fails if a label was never
+	// bound or the bytecode is too long for 16 bit jump offsets.
+	bool finish(std::string& error);
+	bool finish();
+
+private:
+	struct Relocation
+	{
+		std::uint32_t position;
+		std::uint32_t label;
+	};
+
+	std::vector<std::uint32_t>& out;
+	std::vector<std::uint32_t> labels; // offsets, UNBOUND until bind()
+	std::vector<Relocation> relocations;
+};
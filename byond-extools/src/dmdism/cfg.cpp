@@ -0,0 +1,365 @@
+#include "cfg.h"
+#include "disassembly.h"
+#include "opcodes.h"
+
+#include <algorithm>
+
+namespace
+{
+	bool falls_through(std::uint32_t opcode)
+	{
+		return !(opcode_info(opcode).flags & OPCODE_TERMINATOR);
+	}
+
+	struct DecodedSource
+	{
+		BytecodeView code;
+		const DecodedProc& decoded;
+
+		std::size_t size() const { return decoded.instructions.size(); }
+		std::size_t code_size() const { return code.size; }
+		std::uint32_t offset(std::size_t i) const { return decoded.instructions[i].offset; }
+		std::uint32_t opcode(std::size_t i) const { return decoded.instructions[i].opcode; }
+		std::size_t jump_count(std::size_t i) const { return decoded.instructions[i].jump_count; }
+		std::uint32_t jump(std::size_t i, std::size_t j) const { return decoded.jump_target(code, decoded.instructions[i], j); }
+	};
+
+	struct DisassemblySource
+	{
+		Disassembly& disassembly;
+
+		std::size_t size() const { return disassembly.instructions.size(); }
+		std::size_t code_size() const
+		{
+			Instruction& last = disassembly.instructions.back();
+			return last.offset() + last.size();
+		}
+		std::uint32_t offset(std::size_t i) const { return disassembly.instructions[i].offset(); }
+		std::uint32_t opcode(std::size_t i) const { return (std::uint32_t)disassembly.instructions[i].opcode().opcode(); }
+		std::size_t jump_count(std::size_t i) const { return disassembly.instructions[i].jump_locations().size(); }
+		std::uint32_t jump(std::size_t i, std::size_t j) const { return disassembly.instructions[i].jump_locations()[j]; }
+	};
+
+	void add_edge(ControlFlowGraph& cfg, std::uint32_t from, std::uint32_t to)
+	{
+		std::vector<std::uint32_t>& successors = cfg.blocks[from].successors;
+		if (std::find(successors.begin(), successors.end(), to) == successors.end())
+		{
+			successors.push_back(to);
+			cfg.blocks[to].predecessors.push_back(from);
+		}
+	}
+
+	// Cooper, Harvey and Kennedy's "A Simple, Fast Dominance Algorithm": iterate over the blocks in reverse
+	// postorder until the immediate dominators settle. Procs are small enough that this beats Lengauer-Tarjan.
+	void find_dominators(ControlFlowGraph& cfg)
+	{
+		std::vector<BasicBlock>& blocks = cfg.blocks;
+		std::size_t n = blocks.size();
+
+		std::vector<std::uint32_t> postorder;
+		postorder.reserve(n);
+		std::vector<bool> visited(n);
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> stack = { { 0, 0 } }; // block, next successor
+		visited[0] = true;
+		while (!stack.empty())
+		{
+			auto& [block, next] = stack.back();
+			if (next < blocks[block].successors.size())
+			{
+				std::uint32_t successor = blocks[block].successors[next++];
+				if (!visited[successor])
+				{
+					visited[successor] = true;
+					stack.push_back({ successor, 0 });
+				}
+				continue;
+			}
+			postorder.push_back(block);
+			stack.pop_back();
+		}
+		std::vector<std::uint32_t> rpo_index(n, CFG_NONE);
+		for (std::size_t i = 0; i < postorder.size(); i++)
+		{
+			rpo_index[postorder[i]] = postorder.size() - 1 - i;
+		}
+
+		auto intersect = [&](std::uint32_t a, std::uint32_t b) {
+			while (a != b)
+			{
+				while (rpo_index[a] > rpo_index[b])
+				{
+					a = blocks[a].idom;
+				}
+				while (rpo_index[b] > rpo_index[a])
+				{
+					b = blocks[b].idom;
+				}
+			}
+			return a;
+		};
+		blocks[0].idom = 0;
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (auto block = postorder.rbegin() + 1; block < postorder.rend(); ++block)
+			{
+				std::uint32_t idom = CFG_NONE;
+				for (std::uint32_t predecessor : blocks[*block].predecessors)
+				{
+					if (blocks[predecessor].idom != CFG_NONE)
+					{
+						idom = idom == CFG_NONE ? predecessor : intersect(predecessor, idom);
+					}
+				}
+				if (blocks[*block].idom != idom)
+				{
+					blocks[*block].idom = idom;
+					changed = true;
+				}
+			}
+		}
+
+		// Number the dominator tree so dominates() is two comparisons.
+		std::vector<std::vector<std::uint32_t>> children(n);
+		for (std::uint32_t block = 1; block < n; block++)
+		{
+			if (blocks[block].idom != CFG_NONE)
+			{
+				children[blocks[block].idom].push_back(block);
+			}
+		}
+		std::uint32_t counter = 0;
+		stack = { { 0, 0 } };
+		blocks[0].dom_pre = counter++;
+		while (!stack.empty())
+		{
+			auto& [block, next] = stack.back();
+			if (next < children[block].size())
+			{
+				std::uint32_t child = children[block][next++];
+				blocks[child].dom_pre = counter++;
+				stack.push_back({ child, 0 });
+				continue;
+			}
+			blocks[block].dom_post = counter++;
+			stack.pop_back();
+		}
+
+		for (std::uint32_t block = 0; block < n; block++)
+		{
+			for (std::uint32_t successor : blocks[block].successors)
+			{
+				if (cfg.reachable(block) && rpo_index[successor] <= rpo_index[block] && !cfg.dominates(successor, block))
+				{
+					cfg.irreducible_edges++;
+				}
+			}
+		}
+	}
+
+	void find_loops(ControlFlowGraph& cfg)
+	{
+		std::vector<BasicBlock>& blocks = cfg.blocks;
+		std::vector<std::uint32_t> loop_of_header(blocks.size(), CFG_NONE);
+		for (std::uint32_t block = 0; block < blocks.size(); block++)
+		{
+			for (std::uint32_t successor : blocks[block].successors)
+			{
+				if (!cfg.dominates(successor, block))
+				{
+					continue;
+				}
+				if (loop_of_header[successor] == CFG_NONE)
+				{
+					loop_of_header[successor] = cfg.loops.size();
+					Loop loop;
+					loop.header = successor;
+					cfg.loops.push_back(std::move(loop));
+				}
+				cfg.loops[loop_of_header[successor]].latches.push_back(block);
+			}
+		}
+
+		std::vector<std::uint32_t> mark(blocks.size(), CFG_NONE);
+		for (std::uint32_t i = 0; i < cfg.loops.size(); i++)
+		{
+			Loop& loop = cfg.loops[i];
+			mark[loop.header] = i;
+			std::vector<std::uint32_t> pending = loop.latches;
+			while (!pending.empty())
+			{
+				std::uint32_t block = pending.back();
+				pending.pop_back();
+				if (mark[block] == i)
+				{
+					continue;
+				}
+				mark[block] = i;
+				for (std::uint32_t predecessor : blocks[block].predecessors)
+				{
+					if (cfg.reachable(predecessor))
+					{
+						pending.push_back(predecessor);
+					}
+				}
+			}
+			for (std::uint32_t block = 0; block < blocks.size(); block++)
+			{
+				if (mark[block] == i)
+				{
+					loop.blocks.push_back(block);
+				}
+			}
+		}
+
+		// Natural loops with different headers are either nested or disjoint, so going from the biggest to the
+		// smallest, whatever loop a header is already in is its parent.
+		std::stable_sort(cfg.loops.begin(), cfg.loops.end(), [](const Loop& a, const Loop& b) {
+			return a.blocks.size() > b.blocks.size();
+		});
+		for (std::uint32_t i = 0; i < cfg.loops.size(); i++)
+		{
+			Loop& loop = cfg.loops[i];
+			loop.parent = blocks[loop.header].loop;
+			if (loop.parent != CFG_NONE)
+			{
+				loop.depth = cfg.loops[loop.parent].depth + 1;
+			}
+			for (std::uint32_t block : loop.blocks)
+			{
+				blocks[block].loop = i;
+			}
+		}
+	}
+
+	template<typename Source>
+	bool build(const Source& source, ControlFlowGraph& out)
+	{
+		out.blocks.clear();
+		out.loops.clear();
+		out.irreducible_edges = 0;
+		std::size_t n = source.size();
+		if (!n)
+		{
+			return true;
+		}
+		std::size_t code_size = source.code_size();
+		std::vector<std::int32_t> index_of(code_size + 1, -1);
+		for (std::size_t i = 0; i < n; i++)
+		{
+			index_of[source.offset(i)] = i;
+		}
+
+		std::vector<bool> leader(n);
+		leader[0] = true;
+		for (std::size_t i = 0; i < n; i++)
+		{
+			std::size_t jumps = source.jump_count(i);
+			for (std::size_t j = 0; j < jumps; j++)
+			{
+				std::uint32_t target = source.jump(i, j);
+				if (target > code_size || (target < code_size && index_of[target] < 0))
+				{
+					return false;
+				}
+				if (target < code_size)
+				{
+					leader[index_of[target]] = true;
+				}
+			}
+			if ((jumps || !falls_through(source.opcode(i))) && i + 1 < n)
+			{
+				leader[i + 1] = true;
+			}
+		}
+
+		std::vector<std::uint32_t> block_of(n);
+		for (std::size_t i = 0; i < n; i++)
+		{
+			if (leader[i])
+			{
+				if (!out.blocks.empty())
+				{
+					out.blocks.back().end = source.offset(i);
+				}
+				BasicBlock block;
+				block.first = i;
+				block.begin = source.offset(i);
+				out.blocks.push_back(std::move(block));
+			}
+			out.blocks.back().count++;
+			block_of[i] = out.blocks.size() - 1;
+		}
+		out.blocks.back().end = code_size;
+
+		for (std::uint32_t block = 0; block < out.blocks.size(); block++)
+		{
+			std::size_t last = out.blocks[block].first + out.blocks[block].count - 1;
+			for (std::size_t j = 0; j < source.jump_count(last); j++)
+			{
+				std::uint32_t target = source.jump(last, j);
+				if (target < code_size) // a jump to the end just leaves the proc
+				{
+					add_edge(out, block, block_of[index_of[target]]);
+				}
+			}
+			if (falls_through(source.opcode(last)) && last + 1 < n)
+			{
+				add_edge(out, block, block + 1);
+			}
+		}
+
+		find_dominators(out);
+		find_loops(out);
+		return true;
+	}
+}
+
+bool ControlFlowGraph::dominates(std::uint32_t a, std::uint32_t b) const
+{
+	if (!reachable(a) || !reachable(b))
+	{
+		return false;
+	}
+	return blocks[a].dom_pre <= blocks[b].dom_pre && blocks[b].dom_post <= blocks[a].dom_post;
+}
+
+std::uint32_t ControlFlowGraph::block_at(std::uint32_t offset) const
+{
+	if (blocks.empty() || offset >= blocks.back().end)
+	{
+		return CFG_NONE;
+	}
+	auto after = std::upper_bound(blocks.begin(), blocks.end(), offset, [](std::uint32_t offset, const BasicBlock& block) {
+		return offset < block.begin;
+	});
+	return after - blocks.begin() - 1;
+}
+
+std::uint32_t ControlFlowGraph::loop_at(std::uint32_t offset) const
+{
+	std::uint32_t block = block_at(offset);
+	return block == CFG_NONE ? CFG_NONE : blocks[block].loop;
+}
+
+std::size_t ControlFlowGraph::edge_count() const
+{
+	std::size_t edges = 0;
+	for (const BasicBlock& block : blocks)
+	{
+		edges += block.successors.size();
+	}
+	return edges;
+}
+
+bool build_cfg(BytecodeView code, const DecodedProc& decoded, ControlFlowGraph& out)
+{
+	return build(DecodedSource { code, decoded }, out);
+}
+
+bool build_cfg(Disassembly& disassembly, ControlFlowGraph& out)
+{
+	return build(DisassemblySource { disassembly }, out);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "decoder.h"
+
+#include <cstdint>
+#include <vector>
+
+class Disassembly;
+
+const std::uint32_t CFG_NONE = 0xFFFFFFFF;
+
+struct BasicBlock
+{
+	std::uint32_t first = 0; // index of the first instruction
+	std::uint32_t count = 0; // number of instructions
+	std::uint32_t begin = 0; // bytecode offsets, [begin, end)
+	std::uint32_t end = 0;
+	std::vector<std::uint32_t> successors; // jump targets in operand order, then the fallthrough
+	std::vector<std::uint32_t> predecessors;
+	std::uint32_t idom = CFG_NONE; // immediate dominator, the entry block is its own; CFG_NONE if unreachable
+	std::uint32_t loop = CFG_NONE; // innermost loop containing this block
+	// Position in the dominator tree, so dominance checks don't have to walk it.
+	std::uint32_t dom_pre = 0;
+	std::uint32_t dom_post = 0;
+};
+
+// A natural loop: the blocks that can reach one of the back edges into `header` without passing through it.
+struct Loop
+{
+	std::uint32_t header = CFG_NONE;
+	std::vector<std::uint32_t> latches; // blocks with a back edge to the header
+	std::vector<std::uint32_t> blocks; // includes the header, in block order
+	std::uint32_t parent = CFG_NONE;
+	std::uint32_t depth = 1;
+};
+
+struct ControlFlowGraph
+{
+	std::vector<BasicBlock> blocks; // in bytecode order, block 0 is the entry
+	std::vector<Loop> loops; // outer loops before the loops nested in them
+	// Edges into a block that doesn't dominate the source, which only loops entered in the middle have.
+	// Their loops aren't found.
+	std::uint32_t irreducible_edges = 0;
+
+	bool reachable(std::uint32_t block) const { return blocks[block].idom != CFG_NONE; }
+	bool dominates(std::uint32_t a, std::uint32_t b) const;
+	// The block containing the instruction at `offset`, CFG_NONE if it's past the end.
+	std::uint32_t block_at(std::uint32_t offset) const;
+	// The innermost loop running the instruction at `offset`, for attributing samples or counts to loops.
+	std::uint32_t loop_at(std::uint32_t offset) const;
+	std::size_t edge_count() const;
+};
+
+// Splits a proc into basic blocks, links them and finds dominators and loops. Returns false if a jump lands in
+// the middle of an instruction. Like decode(), this never touches BYOND, so it can run on any thread.
+bool build_cfg(BytecodeView code, const DecodedProc& decoded, ControlFlowGraph& out);
+bool build_cfg(Disassembly& disassembly, ControlFlowGraph& out);
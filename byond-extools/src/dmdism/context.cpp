@@ -8,7 +8,7 @@
 
 std::uint32_t Context::peek()
 {
-	if (current_offset_ >= buffer_.size())
+	if (current_offset_ >= buffer_.size)
 	{
 		std::cout << "READ PAST END OF BYTECODE" << std::endl;
 		return (std::uint32_t) BYTECODE_RET;
@@ -18,7 +18,7 @@ std::uint32_t Context::peek()
 
 std::uint32_t Context::take()
 {
-	if (current_offset_ >= buffer_.size())
+	if (current_offset_ >= buffer_.size)
 	{
 		std::cout << "READ PAST END OF BYTECODE" << std::endl;
 		return (std::uint32_t) BYTECODE_END;
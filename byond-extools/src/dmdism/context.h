@@ -5,14 +5,16 @@
 
 #include "../core/proc_management.h"
 #include "instruction.h"
+#include "decoder.h"
 
 class Context
 {
 public:
-	Context(std::vector<std::uint32_t> bc, const std::vector<Core::Proc>& ps) : buffer_(bc), procs_(ps) {}
-	std::vector<std::uint32_t> buffer() const { return buffer_; }
+	// Doesn't copy the bytecode, it has to outlive the context.
+	Context(BytecodeView bc, const std::vector<Core::Proc>& ps) : buffer_(bc), procs_(ps) {}
+	BytecodeView buffer() const { return buffer_; }
 	const std::vector<Core::Proc>& procs() const { return procs_; }
-	bool more() const { return current_offset_ < buffer_.size(); }
+	bool more() const { return current_offset_ < buffer_.size; }
 
 	std::uint32_t peek();
 	std::uint32_t take();
@@ -22,7 +24,7 @@ public:
 	std::uint32_t current_offset() const { return current_offset_; };
 
 private:
-	std::vector<std::uint32_t> buffer_;
+	BytecodeView buffer_;
 	std::uint32_t current_offset_ = 0;
 	const std::vector<Core::Proc>& procs_;
 };
@@ -0,0 +1,262 @@
+#include "decoder.h"
+#include "instruction.h"
+#include "opcodes.h"
+
+namespace
+{
+	struct Layout
+	{
+		OperandShape shape;
+		std::uint8_t count;
+	};
+
+	// The decoder only needs the operand layout, which is in the opcode table for stock opcodes.
+	bool layout_of(std::uint32_t opcode, Layout& out)
+	{
+		const OpcodeInfo& info = opcode_info(opcode);
+		if (info.flags & OPCODE_KNOWN)
+		{
+			out = { info.shape, info.operands };
+			return true;
+		}
+		unsigned int count;
+		if (custom_opcode_operands(opcode, count))
+		{
+			out = { OperandShape::ARGS, (std::uint8_t)count };
+			return true;
+		}
+		out = { OperandShape::ARGS, 0 };
+		return false;
+	}
+
+	struct Cursor
+	{
+		BytecodeView code;
+		std::size_t pos;
+		bool overrun = false;
+
+		std::uint32_t peek()
+		{
+			if (pos >= code.size)
+			{
+				overrun = true;
+				return 0;
+			}
+			return code[pos];
+		}
+
+		std::uint32_t take()
+		{
+			std::uint32_t value = peek();
+			pos++;
+			return value;
+		}
+	};
+
+	void skip_var(Cursor& c, VarOperand& var)
+	{
+		decode_var(c.code, c.pos, var);
+		c.pos = var.end;
+		if (c.pos > c.code.size)
+		{
+			c.overrun = true;
+		}
+	}
+
+	// Mirrors Disassembler::disassemble_proc.
+	void skip_proc(Cursor& c)
+	{
+		switch ((AccessModifier)c.peek())
+		{
+		case AccessModifier::PROC_NO_RET:
+		case AccessModifier::PROC:
+		case AccessModifier::SRC_PROC:
+		case AccessModifier::SRC_PROC_SPEC:
+			c.pos += 3;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+bool decode_var(BytecodeView code, std::size_t pos, VarOperand& out)
+{
+	Cursor c { code, pos };
+	out.modifier = c.peek();
+	out.base = 0;
+	out.id = 0;
+	out.chain.clear();
+	switch ((AccessModifier)out.modifier)
+	{
+	case AccessModifier::SUBVAR:
+	{
+		c.take();
+		out.base = c.take();
+		AccessModifier base = (AccessModifier)out.base;
+		if (base == AccessModifier::SRC_PROC_SPEC || base == AccessModifier::PROC)
+		{
+			break;
+		}
+		if (base != AccessModifier::SRC && base != AccessModifier::WORLD && base != AccessModifier::CACHE && base != AccessModifier::DOT)
+		{
+			out.id = c.take();
+		}
+		// Every link but the last is prefixed with SUBVAR or CACHE. A proc reference ends the chain without a link.
+		bool more = true;
+		while (more && !c.overrun)
+		{
+			switch ((AccessModifier)c.peek())
+			{
+			case AccessModifier::SUBVAR:
+			case AccessModifier::CACHE:
+				c.take();
+				out.chain.push_back(c.take());
+				break;
+			case AccessModifier::PROC_NO_RET:
+			case AccessModifier::PROC:
+			case AccessModifier::SRC_PROC:
+			case AccessModifier::SRC_PROC_SPEC:
+				more = false;
+				break;
+			default:
+				out.chain.push_back(c.take());
+				more = false;
+				break;
+			}
+		}
+		break;
+	}
+	case AccessModifier::LOCAL:
+	case AccessModifier::GLOBAL:
+	case AccessModifier::ARG:
+	case AccessModifier::INITIAL:
+		c.take();
+		out.id = c.take();
+		break;
+	case AccessModifier::PROC_NO_RET:
+	case AccessModifier::PROC:
+	case AccessModifier::SRC_PROC:
+	case AccessModifier::SRC_PROC_SPEC:
+		out.end = pos;
+		return false;
+	default: // CACHE, WORLD, NULL_, DOT, SRC, ARGS and plain string ids
+		c.take();
+		break;
+	}
+	out.end = c.pos;
+	return true;
+}
+
+void decode(BytecodeView code, DecodedProc& out)
+{
+	out.instructions.clear();
+	out.jump_operands.clear();
+	out.complete = true;
+
+	VarOperand var;
+	std::size_t pos = 0;
+	while (pos < code.size)
+	{
+		DecodedInstruction instr {};
+		instr.opcode = code[pos];
+		instr.offset = pos;
+		instr.first_jump = out.jump_operands.size();
+
+		Layout layout;
+		instr.known = layout_of(instr.opcode, layout);
+		Cursor c { code, pos + 1 };
+		auto jump = [&]() {
+			out.jump_operands.push_back(c.pos);
+			c.take();
+		};
+
+		switch (layout.shape)
+		{
+		case OperandShape::ARGS:
+			c.pos += layout.count;
+			break;
+		case OperandShape::VAR:
+			instr.var_operand = c.pos;
+			skip_var(c, var);
+			break;
+		case OperandShape::ARGS_VAR:
+			c.pos += layout.count;
+			instr.var_operand = c.pos;
+			skip_var(c, var);
+			break;
+		case OperandShape::JUMP:
+			jump();
+			c.pos += layout.count - 1;
+			break;
+		case OperandShape::CALL:
+			instr.var_operand = c.pos;
+			skip_var(c, var);
+			skip_proc(c);
+			break;
+		case OperandShape::PUSHVAL:
+			c.pos += c.take() == DataType::NUMBER ? 2 : 1;
+			break;
+		case OperandShape::SWITCH:
+		{
+			std::uint32_t cases = c.take();
+			for (std::uint32_t i = 0; i < cases && !c.overrun; i++)
+			{
+				c.pos += c.take() == DataType::NUMBER ? 2 : 1;
+				jump();
+			}
+			jump();
+			break;
+		}
+		case OperandShape::PICK_SWITCH:
+		{
+			std::uint32_t cases = c.take();
+			for (std::uint32_t i = 0; i < cases && !c.overrun; i++)
+			{
+				c.take();
+				jump();
+			}
+			jump();
+			break;
+		}
+		}
+
+		if (c.overrun || c.pos > code.size)
+		{
+			// Drop jump operands that point past the end and keep whatever is left as one instruction.
+			while (out.jump_operands.size() > instr.first_jump && out.jump_operands.back() >= code.size)
+			{
+				out.jump_operands.pop_back();
+			}
+			if (instr.var_operand >= code.size)
+			{
+				instr.var_operand = 0;
+			}
+			c.pos = code.size;
+			out.complete = false;
+		}
+		instr.length = c.pos - pos;
+		instr.jump_count = out.jump_operands.size() - instr.first_jump;
+		out.instructions.push_back(instr);
+		pos = c.pos;
+	}
+}
+
+Instruction DecodedProc::instruction(BytecodeView code, std::size_t i) const
+{
+	const DecodedInstruction& decoded = instructions[i];
+	Instruction instr(decoded.opcode);
+	instr.set_offset(decoded.offset);
+	std::uint32_t next_jump = decoded.first_jump;
+	std::uint32_t last_jump = decoded.first_jump + decoded.jump_count;
+	for (std::uint32_t pos = decoded.offset + 1; pos < decoded.offset + decoded.length; pos++)
+	{
+		instr.add_byte(code[pos]);
+		if (next_jump < last_jump && jump_operands[next_jump] == pos)
+		{
+			instr.add_jump(code[pos]);
+			next_jump++;
+		}
+	}
+	return instr;
+}
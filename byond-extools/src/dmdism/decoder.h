@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Instruction;
+
+// A read-only view of bytecode that doesn't own it, like std::span<const std::uint32_t> in C++20.
+struct BytecodeView
+{
+	const std::uint32_t* data = nullptr;
+	std::size_t size = 0;
+
+	BytecodeView() {}
+	BytecodeView(const std::uint32_t* data, std::size_t size) : data(data), size(size) {}
+	BytecodeView(const std::vector<std::uint32_t>& v) : data(v.data()), size(v.size()) {}
+
+	std::uint32_t operator[](std::size_t i) const { return data[i]; }
+	const std::uint32_t* begin() const { return data; }
+	const std::uint32_t* end() const { return data + size; }
+};
+
+// What the decoder knows about one instruction. Operands are the words in [offset + 1, offset + length).
+struct DecodedInstruction
+{
+	std::uint32_t opcode;
+	std::uint32_t offset;
+	std::uint16_t length;
+	std::uint16_t jump_count;
+	std::uint32_t first_jump; // index into DecodedProc::jump_operands
+	std::uint32_t var_operand; // offset of the access modifier for instructions that read or write a var, 0 if there is none
+	bool known; // in opcodes_table.inl, or a custom opcode with registered operands
+};
+
+struct DecodedProc
+{
+	std::vector<DecodedInstruction> instructions;
+	// Offsets of every jump operand, in order. The jump target is the word at that offset.
+	std::vector<std::uint32_t> jump_operands;
+	// False if the last instruction's operands run past the end of the bytecode.
+	bool complete = true;
+
+	std::uint16_t jump_target(BytecodeView code, const DecodedInstruction& instr, std::size_t i) const
+	{
+		return code[jump_operands[instr.first_jump + i]];
+	}
+	// Builds a full Instruction for code that wants to edit it, without any of the text the Disassembler adds.
+	Instruction instruction(BytecodeView code, std::size_t i) const;
+};
+
+// A var operand split into its parts. `modifier` is the first word, an AccessModifier or the string id of a
+// var of src. LOCAL, ARG, GLOBAL and INITIAL have their operand in `id`. A SUBVAR chain starts at `base`, with
+// `id` for bases that take one, and walks the vars in `chain`, which are string ids. SUBVAR with a PROC or
+// SRC_PROC_SPEC base names a proc rather than a var and has an empty chain.
+struct VarOperand
+{
+	std::uint32_t modifier = 0;
+	std::uint32_t base = 0;
+	std::uint32_t id = 0;
+	std::vector<std::uint32_t> chain;
+	std::uint32_t end = 0; // offset of whatever follows the var, past the end of the bytecode if it's cut off
+};
+
+// Reads the var operand at `pos`. Returns false if there is only a proc reference there, which isn't part of
+// the var. Words past the end of the bytecode read as 0. Everything that looks inside var operands goes through
+// this, so the layout is only written down once. Reuses the storage in `out`.
+bool decode_var(BytecodeView code, std::size_t pos, VarOperand& out);
+
+// Splits bytecode into instructions without rendering anything, so it never touches the string table and is
+// safe to run on other threads. Reuses the storage in `out`. Use Disassembler when you need text.
+void decode(BytecodeView code, DecodedProc& out);
@@ -9,15 +9,19 @@
 #include "context.h"
 
 
-Disassembler::Disassembler(std::vector<std::uint32_t> bc, const std::vector<Core::Proc>& ps)
+Disassembler::Disassembler(std::vector<std::uint32_t>&& bc, const std::vector<Core::Proc>& ps) : owned_(std::move(bc))
 {
-	context_ = std::make_unique<Context>(bc, ps);
+	context_ = std::make_unique<Context>(BytecodeView(owned_), ps);
 }
 
-Disassembler::Disassembler(std::uint32_t* bc, unsigned int bc_len, const std::vector<Core::Proc>& ps)
+Disassembler::Disassembler(const std::vector<std::uint32_t>& bc, const std::vector<Core::Proc>& ps)
 {
-	std::vector<std::uint32_t> v(bc, bc + bc_len);
-	context_ = std::make_unique<Context>(v, ps);
+	context_ = std::make_unique<Context>(BytecodeView(bc), ps);
+}
+
+Disassembler::Disassembler(const std::uint32_t* bc, unsigned int bc_len, const std::vector<Core::Proc>& ps)
+{
+	context_ = std::make_unique<Context>(BytecodeView(bc, bc_len), ps);
 }
 
 Disassembly Disassembler::disassemble()
@@ -48,138 +52,86 @@ Instruction Disassembler::disassemble_next()
 	return instr;
 }
 
-std::vector<unsigned int> Disassembler::disassemble_subvar_follows(Instruction& instr)
+bool Disassembler::disassemble_var(Instruction& instr)
 {
-	std::vector<unsigned int> result;
-	while (true)
+	VarOperand var;
+	if (!decode_var(context_->buffer(), context_->current_offset(), var))
 	{
-		switch ((AccessModifier) context_->peek())
-		{
-			case AccessModifier::SUBVAR:
-			case AccessModifier::CACHE:
-				context_->eat(&instr);
-				result.push_back(context_->eat(&instr));
-				break;
-
-			case AccessModifier::PROC_NO_RET:
-			case AccessModifier::PROC:
-			case AccessModifier::SRC_PROC:
-			case AccessModifier::SRC_PROC_SPEC:
-				return result;
-
-			default:
-				result.push_back(context_->eat(&instr));
-				return result;
-		}
+		return false;
+	}
+	for (std::uint32_t i = context_->current_offset(); i < var.end; i++)
+	{
+		context_->eat(&instr);
 	}
-}
 
-bool Disassembler::disassemble_var(Instruction& instr)
-{
-	switch ((AccessModifier) context_->peek())
+	std::string modifier_name = "UNKNOWN_MODIFIER";
+	switch ((AccessModifier)var.modifier)
 	{
 	case AccessModifier::SUBVAR:
 	{
-		std::uint32_t val = context_->eat(&instr);
 		instr.opcode().add_info(" SUBVAR");
-
-		const AccessModifier mod = (AccessModifier)context_->eat(&instr);
-		if (mod == AccessModifier::SRC_PROC_SPEC || mod == AccessModifier::PROC)
+		if ((AccessModifier)var.base == AccessModifier::SRC_PROC_SPEC || (AccessModifier)var.base == AccessModifier::PROC)
 		{
 			instr.acc_base = { (AccessModifier)0, 0 };
 			instr.acc_chain = std::vector<unsigned int>();
 			break;
 		}
-		unsigned int id = 0;
-		if (mod != AccessModifier::SRC && mod != AccessModifier::WORLD && mod != AccessModifier::CACHE && mod != AccessModifier::DOT)
-		{
-			id = context_->eat(&instr);
-		}
-		instr.acc_base = { mod, id };
-		instr.acc_chain = disassemble_subvar_follows(instr);
+		instr.acc_base = { (AccessModifier)var.base, var.id };
+		instr.acc_chain = std::vector<unsigned int>(var.chain.begin(), var.chain.end());
 
-		std::string modifier_name = "UNKNOWN_MODIFIER";
-		if (const auto ptr = modifier_names.find(static_cast<AccessModifier>(instr.acc_base.first)); ptr != modifier_names.end())
+		if (const char* name = ::modifier_name(var.base))
 		{
-			modifier_name = ptr->second;
+			modifier_name = name;
 		}
-
 		instr.add_comment(modifier_name);
-		for(const auto follow_name_id : instr.acc_chain)
+		for (const auto follow_name_id : instr.acc_chain)
 		{
 			instr.add_comment("." + Core::GetStringFromId(follow_name_id));
 		}
 		instr.add_comment(" ");
-
 		break;
 	}
 
 	case AccessModifier::LOCAL:
 	case AccessModifier::GLOBAL:
-	//case CACHE:
 	case AccessModifier::ARG:
 	{
-		std::uint32_t type = context_->eat(&instr);
-		std::uint32_t localno = context_->eat(&instr);
-
-		std::string modifier_name = "UNKNOWN_MODIFIER";
-		if (auto ptr = modifier_names.find(static_cast<AccessModifier>(type)); ptr != modifier_names.end())
+		if (const char* name = ::modifier_name(var.modifier))
 		{
-			modifier_name = ptr->second;
+			modifier_name = name;
 		}
-
-		instr.opcode().add_info(" " + modifier_name + std::to_string(localno));
-		instr.add_comment(modifier_name + std::to_string(localno));
+		instr.opcode().add_info(" " + modifier_name + std::to_string(var.id));
+		instr.add_comment(modifier_name + std::to_string(var.id));
 		break;
 	}
 	case AccessModifier::INITIAL:
-	{
-		context_->eat(&instr);
 		instr.add_comment("INITIAL(");
-		std::uint32_t val = context_->eat(&instr);
-		instr.add_comment(byond_tostring(val));
+		instr.add_comment(byond_tostring(var.id));
 		instr.add_comment(")");
 		break;
-	}
 	case AccessModifier::CACHE:
-	{
-		context_->eat(&instr);
 		instr.add_comment("CACHE");
 		break;
-	}
 	case AccessModifier::WORLD:
 	case AccessModifier::NULL_:
 	case AccessModifier::DOT:
 	case AccessModifier::SRC:
 	{
-		std::uint32_t type = context_->eat(&instr);
-
-		std::string modifier_name = "UNKNOWN_MODIFIER";
-		if (auto ptr = modifier_names.find(static_cast<AccessModifier>(type)); ptr != modifier_names.end())
+		if (const char* name = ::modifier_name(var.modifier))
 		{
-			modifier_name = ptr->second;
+			modifier_name = name;
 		}
-
 		instr.opcode().add_info(" " + modifier_name);
 		instr.add_comment(modifier_name);
 		break;
 	}
 	case AccessModifier::ARGS:
-		context_->eat(&instr);
 		instr.add_comment("ARGS");
 		break;
-	case AccessModifier::PROC_NO_RET:
-	case AccessModifier::PROC:
-	case AccessModifier::SRC_PROC:
-	case AccessModifier::SRC_PROC_SPEC:
-		return false;
 	default:
-	{
-		std::uint32_t val = context_->eat(&instr);
-		instr.add_comment(byond_tostring(val));
+		instr.add_comment(byond_tostring(var.modifier));
 		break;
 	}
-	}
 	return true;
 }
 
@@ -15,14 +15,17 @@
 class Disassembler
 {
 public:
-	Disassembler(std::vector<std::uint32_t> bc, const std::vector<Core::Proc>& ps);
-	Disassembler(std::uint32_t* bc, unsigned int bc_len, const std::vector<Core::Proc>& ps);
+	// Takes ownership of the bytecode.
+	Disassembler(std::vector<std::uint32_t>&& bc, const std::vector<Core::Proc>& ps);
+	// These two only look at the bytecode, which has to stay alive until disassemble() returns.
+	Disassembler(const std::vector<std::uint32_t>& bc, const std::vector<Core::Proc>& ps);
+	Disassembler(const std::uint32_t* bc, unsigned int bc_len, const std::vector<Core::Proc>& ps);
 	Disassembly disassemble();
 
 	Context* context() const { return context_.get(); }
 
+	// Renders what decode_var reads. Returns false, having eaten nothing, if there's only a proc reference.
 	bool disassemble_var(Instruction& instr);
-	std::vector<unsigned int> disassemble_subvar_follows(Instruction& instr);
 	bool disassemble_proc(Instruction& instr);
 	void add_call_args(Instruction& instr, unsigned int num_args);
 
@@ -30,6 +33,7 @@ public:
 	void debug_line(uint32_t line) { last_line = line; }
 
 private:
+	std::vector<std::uint32_t> owned_;
 	std::unique_ptr<Context> context_;
 	std::string last_file;
 	uint32_t last_line = 0;
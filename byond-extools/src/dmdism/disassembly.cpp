@@ -31,7 +31,8 @@ ForwardIt local_lower_bound(ForwardIt first, ForwardIt last, const T& value, Com
 std::vector<std::uint32_t> Disassembly::assemble()
 {
 	std::vector<std::uint32_t> ret;
-	for (Instruction i : instructions)
+	ret.reserve(bytecount());
+	for (Instruction& i : instructions)
 	{
 		for (int op : i.bytes())
 		{
@@ -114,7 +115,7 @@ void Disassembly::recalculate_offsets()
 Disassembly Disassembly::from_proc(Core::Proc& proc)
 {
 	std::uint32_t* bytecode = proc.get_bytecode();
-	Disassembly dis = Disassembler(std::vector<uint32_t>(bytecode, bytecode + proc.get_bytecode_length()), Core::get_all_procs()).disassemble();
+	Disassembly dis = Disassembler(bytecode, proc.get_bytecode_length(), Core::get_all_procs()).disassemble();
 	dis.proc = &proc;
 	return dis;
 }
@@ -0,0 +1,143 @@
+#include "../core/core.h"
+#include "../third_party/json.hpp"
+#include "cfg.h"
+#include "decoder.h"
+#include "disassembler.h"
+
+#include <chrono>
+
+// Decodes every proc and reports how long it took, in milliseconds. Pass "full" to also time the text
+// disassembler the debugger uses, which is much slower.
+extern "C" EXPORT const char* disassembler_benchmark(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return "";
+	}
+	std::vector<Core::Proc>& procs = Core::get_all_procs();
+	std::size_t instructions = 0;
+	std::size_t words = 0;
+	DecodedProc decoded;
+	auto start = std::chrono::steady_clock::now();
+	for (Core::Proc& proc : procs)
+	{
+		BytecodeView code(proc.get_bytecode(), proc.get_bytecode_length());
+		decode(code, decoded);
+		instructions += decoded.instructions.size();
+		words += code.size;
+	}
+	auto decoded_at = std::chrono::steady_clock::now();
+	nlohmann::json stats = {
+		{"procs", procs.size()},
+		{"instructions", instructions},
+		{"words", words},
+		{"decode_ms", std::chrono::duration<double, std::milli>(decoded_at - start).count()},
+	};
+	if (n_args > 0 && !strcmp(args[0], "full"))
+	{
+		for (Core::Proc& proc : procs)
+		{
+			Disassembler(proc.get_bytecode(), proc.get_bytecode_length(), procs).disassemble();
+		}
+		stats["disassemble_ms"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decoded_at).count();
+	}
+	result = stats.dump();
+	return result.c_str();
+}
+
+// Builds the control flow graph of every proc and reports how long it took, with totals of what it found.
+extern "C" EXPORT const char* cfg_benchmark(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return "";
+	}
+	std::vector<Core::Proc>& procs = Core::get_all_procs();
+	std::size_t blocks = 0;
+	std::size_t edges = 0;
+	std::size_t loops = 0;
+	std::size_t irreducible_edges = 0;
+	std::size_t failed = 0;
+	DecodedProc decoded;
+	ControlFlowGraph cfg;
+	double decode_ms = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (Core::Proc& proc : procs)
+	{
+		BytecodeView code(proc.get_bytecode(), proc.get_bytecode_length());
+		auto decode_start = std::chrono::steady_clock::now();
+		decode(code, decoded);
+		decode_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decode_start).count();
+		if (!build_cfg(code, decoded, cfg))
+		{
+			failed++;
+			continue;
+		}
+		blocks += cfg.blocks.size();
+		edges += cfg.edge_count();
+		loops += cfg.loops.size();
+		irreducible_edges += cfg.irreducible_edges;
+	}
+	double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	result = nlohmann::json({
+		{"procs", procs.size()},
+		{"blocks", blocks},
+		{"edges", edges},
+		{"loops", loops},
+		{"irreducible_edges", irreducible_edges},
+		{"failed", failed},
+		{"decode_ms", decode_ms},
+		{"cfg_ms", total_ms - decode_ms},
+	}).dump();
+	return result.c_str();
+}
+
+// Argument: proc path. Returns its basic blocks and loops as JSON, or "" if the proc can't be analysed.
+extern "C" EXPORT const char* proc_cfg(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize() || n_args < 1)
+	{
+		return "";
+	}
+	Core::Proc* proc = Core::try_get_proc(args[0]);
+	if (!proc)
+	{
+		return "";
+	}
+	BytecodeView code(proc->get_bytecode(), proc->get_bytecode_length());
+	DecodedProc decoded;
+	decode(code, decoded);
+	ControlFlowGraph cfg;
+	if (!build_cfg(code, decoded, cfg))
+	{
+		return "";
+	}
+	auto index = [](std::uint32_t i) { return i == CFG_NONE ? nlohmann::json() : nlohmann::json(i); };
+	std::vector<nlohmann::json> blocks;
+	for (const BasicBlock& block : cfg.blocks)
+	{
+		blocks.push_back({
+			{"begin", block.begin},
+			{"end", block.end},
+			{"successors", block.successors},
+			{"idom", index(block.idom)},
+			{"loop", index(block.loop)},
+		});
+	}
+	std::vector<nlohmann::json> loops;
+	for (const Loop& loop : cfg.loops)
+	{
+		loops.push_back({
+			{"header", loop.header},
+			{"latches", loop.latches},
+			{"blocks", loop.blocks},
+			{"parent", index(loop.parent)},
+			{"depth", loop.depth},
+		});
+	}
+	result = nlohmann::json({ {"blocks", blocks}, {"loops", loops}, {"irreducible_edges", cfg.irreducible_edges} }).dump();
+	return result.c_str();
+}
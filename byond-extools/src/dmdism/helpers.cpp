@@ -8,13 +8,20 @@ std::string byond_tostring(int idx)
 }
 
 std::string tohex(int numero) {
-	std::stringstream stream;
-	stream << std::hex << std::uppercase << numero;
-	return "0x" + std::string(stream.str());
+	static const char digits[] = "0123456789ABCDEF";
+	char buffer[8];
+	char* start = buffer + sizeof(buffer);
+	std::uint32_t value = numero;
+	do
+	{
+		*--start = digits[value & 0xF];
+		value >>= 4;
+	} while (value);
+	std::string result = "0x";
+	result.append(start, buffer + sizeof(buffer));
+	return result;
 }
 
 std::string todec(int numero) {
-	std::stringstream stream;
-	stream << std::dec << numero;
-	return std::string(stream.str());
+	return std::to_string(numero);
 }
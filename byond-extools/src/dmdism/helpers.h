@@ -1,7 +1,6 @@
 #pragma once
 
 #include <string>
-#include <sstream>
 #include "../core/core.h"
 #include "../core/byond_functions.h"
 
@@ -22,9 +22,9 @@ void dis_custom_pushval(Instruction* instr, Context* context, Disassembler* dism
 		return;
 	}
 
-	if (auto ptr = datatype_names.find(static_cast<DataType>(type)); ptr != datatype_names.end())
+	if (const char* name = datatype_name(type))
 	{
-		instr->opcode().add_info(" " + ptr->second);
+		instr->opcode().add_info(std::string(" ") + name);
 	}
 	else
 	{
@@ -53,7 +53,7 @@ void dis_custom_switch(Instruction* instruction, Context* context, Disassembler*
 	instruction->add_info("Cases");
 	for (int i = 0; i < case_count; i++)
 	{
-		std::uint32_t type = context->take(); //TODO: Perhaps extract into a separate function to disassemble variables.
+		std::uint32_t type = context->eat(instruction); //TODO: Perhaps extract into a separate function to disassemble variables.
 		if (type == NUMBER)
 		{
 			typedef union
@@ -61,24 +61,24 @@ void dis_custom_switch(Instruction* instruction, Context* context, Disassembler*
 				int i; float f;
 			} funk;
 			funk f;
-			std::uint32_t first_part = context->take();
-			std::uint32_t second_part = context->take();
+			std::uint32_t first_part = context->eat(instruction);
+			std::uint32_t second_part = context->eat(instruction);
 			f.i = first_part << 16 | second_part;
-			std::uint16_t jmp = context->take();
+			std::uint16_t jmp = context->eat(instruction);
 			instruction->add_jump(jmp);
 			instruction->add_info("NUMBER " + std::to_string(f.f) + " -> " + std::to_string(jmp));
 			continue;
 		}
 
-		if (auto ptr = datatype_names.find(static_cast<DataType>(type)); ptr != datatype_names.end())
+		if (const char* name = datatype_name(type))
 		{
-			instruction->add_info(ptr->second + " ");
+			instruction->add_info(std::string(name) + " ");
 		}
 		else
 		{
 			instruction->add_info("??? ");
 		}
-		std::uint32_t value = context->take();
+		std::uint32_t value = context->eat(instruction);
 		if (type == STRING)
 		{
 			instruction->add_info('"' + byond_tostring(value) + '"');
@@ -87,9 +87,11 @@ void dis_custom_switch(Instruction* instruction, Context* context, Disassembler*
 		{
 			instruction->add_info(tohex(value));
 		}
-		instruction->add_info(" -> " + std::to_string(context->take()));
+		std::uint16_t jmp = context->eat(instruction);
+		instruction->add_jump(jmp);
+		instruction->add_info(" -> " + std::to_string(jmp));
 	}
-	std::uint16_t default_jump = context->take();
+	std::uint16_t default_jump = context->eat(instruction);
 	instruction->add_jump(default_jump);
 	instruction->add_comment(std::to_string(default_jump));
 }
@@ -101,12 +103,12 @@ void dis_custom_pick_switch(Instruction* instruction, Context* context, Disassem
 	instruction->add_info("Cases");
 	for (int i = 0; i < case_count; i++)
 	{
-		std::uint32_t threshold = context->take();
-		std::uint32_t jmp = context->take();
+		std::uint32_t threshold = context->eat(instruction);
+		std::uint32_t jmp = context->eat(instruction);
 		instruction->add_jump(jmp);
 		instruction->add_info("if <= " + std::to_string(threshold) + " -> " + std::to_string(jmp));
 	}
-	std::uint16_t default_jump = context->take();
+	std::uint16_t default_jump = context->eat(instruction);
 	instruction->add_jump(default_jump);
 	instruction->add_comment(std::to_string(default_jump));
 }
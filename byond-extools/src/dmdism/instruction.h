@@ -33,7 +33,12 @@ public:
 	bool operator==(const std::uint32_t rhs);
 
 	std::vector<unsigned short>& jump_locations() { return jump_locations_; }
-	void add_jump(unsigned short off) { jump_locations_.push_back(off); }
+	// Must be called right after the jump operand was eaten, so the operand's position in bytes() is known.
+	void add_jump(unsigned short off) { jump_locations_.push_back(off); jump_operands_.push_back(bytes_.size() - 1); }
+	// Points the i-th jump somewhere else, updating the operand in bytes() as well.
+	void set_jump(std::size_t i, unsigned short off) { jump_locations_.at(i) = off; bytes_.at(jump_operands_.at(i)) = off; }
+	// Position of the i-th jump operand in bytes().
+	std::size_t jump_operand(std::size_t i) const { return jump_operands_.at(i); }
 
 	std::vector<std::string> extra_info() { return extra_info_; }
 	void add_info(std::string s) { extra_info_.push_back(s); }
@@ -48,5 +53,6 @@ protected:
 	std::uint32_t offset_;
 	std::vector<std::string> extra_info_;
 
+	std::vector<std::size_t> jump_operands_;
 	std::vector<unsigned short> jump_locations_; //this is probably a sin but I don't feel like making a subtype of Instruction that supports jump destinations and then having to untangle the disassembler to make them work with all the other types.
 };
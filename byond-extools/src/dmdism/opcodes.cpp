@@ -5,46 +5,18 @@
 #include "context.h"
 #include "instr_custom.h"
 
+#include <array>
+
 static_assert(BYTECODE_END == Bytecode::END);
 static_assert(BYTECODE_RET == Bytecode::RET);
 static_assert(BYTECODE_DBG_LINENO == Bytecode::DBG_LINENO);
 static_assert(BYTECODE_UNK == Bytecode::UNK);
 
-// ----------------------------------------------------------------------------
-// Mnemonic lookup
-
-static const char* const get_mnemonic_raw(Bytecode bytecode)
-{
-    switch (bytecode)
-    {
-#define I(NUMBER, NAME, DIS) \
-    case Bytecode::NAME: \
-        return #NAME;
-#include "opcodes_table.inl"
-#undef I
-    }
-    return "???";
-}
-
-const char* const get_mnemonic(Bytecode bytecode)
-{
-    switch (bytecode)
-    {
-        // These string mnemonics differ from their code names.
-        case Bytecode::DBG_FILE:
-            return "DBG FILE";
-        case Bytecode::DBG_LINENO:
-            return "DBG LINENO";
-        default:
-            return get_mnemonic_raw(bytecode);
-    }
-}
-
 // ----------------------------------------------------------------------------
 // Stock disassemble callbacks
 
 // ADD_INSTR(op) becomes dis_none
-static DisassembleCallback dis_none = nullptr;
+constexpr DisassembleCallback dis_none = nullptr;
 
 // ADD_INSTR_ARG(op, arg) becomes dis_arg<arg>
 template<int COUNT>
@@ -80,18 +52,280 @@ void dis_jump(Instruction* instruction, Context* context, Disassembler* dism)
     }
 }
 
+static std::unordered_map<std::uint32_t, unsigned int> custom_operand_counts;
+
+void set_custom_opcode_operands(std::uint32_t opcode, unsigned int count)
+{
+    custom_operand_counts[opcode] = count;
+}
+
+bool custom_opcode_operands(std::uint32_t opcode, unsigned int& count)
+{
+    auto ptr = custom_operand_counts.find(opcode);
+    if (ptr == custom_operand_counts.end())
+    {
+        return false;
+    }
+    count = ptr->second;
+    return true;
+}
+
+void dis_custom_operands(Instruction* instruction, Context* context, Disassembler* dism)
+{
+    unsigned int count = custom_operand_counts.at((std::uint32_t)instruction->opcode().opcode());
+    for (unsigned int i = 0; i < count; i++)
+    {
+        context->eat_add(instruction);
+    }
+}
+
 // ----------------------------------------------------------------------------
-// Disassemble callback lookup
+// Opcode table
 
-DisassembleCallback get_disassemble_callback(std::uint32_t opcode)
+namespace
 {
-    switch (opcode)
+    struct Layout
+    {
+        OperandShape shape;
+        std::uint8_t operands;
+    };
+
+    // Same names as the disassemble callbacks, so opcodes_table.inl describes the operand layout too.
+    namespace layouts
+    {
+        constexpr Layout dis_none { OperandShape::ARGS, 0 };
+        template<int N> constexpr Layout dis_arg { OperandShape::ARGS, N };
+        constexpr Layout dis_var { OperandShape::VAR, 0 };
+        template<int N> constexpr Layout dis_arg_var { OperandShape::ARGS_VAR, N };
+        template<int N> constexpr Layout dis_jump { OperandShape::JUMP, N };
+        constexpr Layout dis_custom_output_format { OperandShape::ARGS, 2 };
+        constexpr Layout dis_custom_call { OperandShape::CALL, 0 };
+        constexpr Layout dis_custom_callglob { OperandShape::ARGS, 2 };
+        constexpr Layout dis_custom_call_global_arglist { OperandShape::ARGS, 1 };
+        constexpr Layout dis_custom_pushval { OperandShape::PUSHVAL, 0 };
+        constexpr Layout dis_custom_switch { OperandShape::SWITCH, 0 };
+        constexpr Layout dis_custom_pick_switch { OperandShape::PICK_SWITCH, 0 };
+        constexpr Layout dis_custom_dbg_file { OperandShape::ARGS, 1 };
+        constexpr Layout dis_custom_dbg_lineno { OperandShape::ARGS, 1 };
+        constexpr Layout dis_custom_isinlist { OperandShape::ARGS, 1 };
+    }
+
+    struct StackEffect
+    {
+        Bytecode opcode;
+        std::int8_t effect;
+    };
+
+    // Only opcodes whose effect is certain. Everything else stays STACK_VARIABLE, so a verifier gives up on
+    // them rather than trusting a guess. That includes the comparisons and conditional jumps: BYOND passes
+    // their result in ExecutionContext::test_flag, and until that's checked against real disassembly it isn't
+    // clear which of them touch the stack at all.
+    constexpr StackEffect stack_effects[] = {
+        { Bytecode::END, 0 }, { Bytecode::RET, -1 },
+        { Bytecode::JMP, 0 },
+        { Bytecode::DBG_FILE, 0 }, { Bytecode::DBG_LINENO, 0 },
+        { Bytecode::PUSHVAL, 1 }, { Bytecode::PUSHI, 1 }, { Bytecode::POP, -1 },
+        { Bytecode::GETVAR, 1 }, { Bytecode::SETVAR, -1 },
+        { Bytecode::ADD, -1 }, { Bytecode::SUB, -1 }, { Bytecode::MUL, -1 }, { Bytecode::DIV, -1 }, { Bytecode::MOD, -1 }, { Bytecode::POW, -1 },
+        { Bytecode::BINARY_AND, -1 }, { Bytecode::BINARY_OR, -1 }, { Bytecode::BINARY_XOR, -1 }, { Bytecode::LSHIFT, -1 }, { Bytecode::RSHIFT, -1 },
+        { Bytecode::NOT, 0 }, { Bytecode::ANEG, 0 }, { Bytecode::BITWISE_NOT, 0 }, { Bytecode::ABS, 0 }, { Bytecode::SQRT, 0 },
+        { Bytecode::SIN, 0 }, { Bytecode::COS, 0 }, { Bytecode::TAN, 0 }, { Bytecode::ARCSIN, 0 }, { Bytecode::ARCCOS, 0 },
+        { Bytecode::AUGADD, -1 }, { Bytecode::AUGSUB, -1 }, { Bytecode::AUGMUL, -1 }, { Bytecode::AUGDIV, -1 }, { Bytecode::AUGMOD, -1 },
+        { Bytecode::AUGAND, -1 }, { Bytecode::AUGOR, -1 }, { Bytecode::AUGXOR, -1 }, { Bytecode::AUGLSHIFT, -1 }, { Bytecode::AUGRSHIFT, -1 },
+        { Bytecode::PRE_INC, 1 }, { Bytecode::POST_INC, 1 }, { Bytecode::PRE_DEC, 1 }, { Bytecode::POST_DEC, 1 }, { Bytecode::INC, 0 }, { Bytecode::DEC, 0 },
+        { Bytecode::LISTGET, -1 }, { Bytecode::ISNULL, 0 }, { Bytecode::ISNUM, 0 }, { Bytecode::ISTEXT, 0 },
+        { Bytecode::LENGTH, 0 }, { Bytecode::UPPERTEXT, 0 }, { Bytecode::LOWERTEXT, 0 }, { Bytecode::DEL, -1 },
+    };
+
+    constexpr Bytecode calls[] = {
+        Bytecode::CALL, Bytecode::CALLNR, Bytecode::CALLGLOB, Bytecode::CALLPARENT, Bytecode::CALLPATH, Bytecode::CALLNAME,
+        Bytecode::CALLPATH_ARGLIST, Bytecode::CALLNAME_ARGLIST, Bytecode::CALL_GLOBAL_ARGLIST, Bytecode::CALL_LIB, Bytecode::CALL_LIB_ARGLIST,
+    };
+
+    // SWITCH and PICK_SWITCH always take one of their jumps, the last one being the default.
+    constexpr Bytecode terminators[] = {
+        Bytecode::END, Bytecode::RET, Bytecode::JMP, Bytecode::CRASH, Bytecode::SWITCH, Bytecode::PICK_SWITCH,
+    };
+
+    constexpr std::uint32_t opcode_count()
     {
+        std::uint32_t count = 0;
 #define I(NUMBER, NAME, DIS) \
-    case NUMBER: \
-        return DIS;
+        count = count > NUMBER ? count : NUMBER + 1;
 #include "opcodes_table.inl"
 #undef I
+        return count;
+    }
+
+    constexpr OpcodeInfo unknown_opcode { "???", nullptr, OperandShape::ARGS, 0, STACK_VARIABLE, 0 };
+
+    constexpr std::array<OpcodeInfo, opcode_count()> make_opcode_table()
+    {
+        std::array<OpcodeInfo, opcode_count()> table {};
+        for (OpcodeInfo& info : table)
+        {
+            info = unknown_opcode;
+        }
+#define I(NUMBER, NAME, DIS) \
+        table[NUMBER] = { #NAME, DIS, layouts::DIS.shape, layouts::DIS.operands, STACK_VARIABLE, OPCODE_KNOWN };
+#include "opcodes_table.inl"
+#undef I
+        // These string mnemonics differ from their code names.
+        table[(std::uint32_t)Bytecode::DBG_FILE].mnemonic = "DBG FILE";
+        table[(std::uint32_t)Bytecode::DBG_LINENO].mnemonic = "DBG LINENO";
+
+        for (OpcodeInfo& info : table)
+        {
+            if (info.shape == OperandShape::JUMP || info.shape == OperandShape::SWITCH || info.shape == OperandShape::PICK_SWITCH)
+            {
+                info.flags |= OPCODE_JUMP;
+            }
+        }
+        for (const StackEffect& effect : stack_effects)
+        {
+            table[(std::uint32_t)effect.opcode].stack_effect = effect.effect;
+        }
+        for (Bytecode opcode : calls)
+        {
+            table[(std::uint32_t)opcode].flags |= OPCODE_CALL;
+        }
+        for (Bytecode opcode : terminators)
+        {
+            table[(std::uint32_t)opcode].flags |= OPCODE_TERMINATOR;
+        }
+        return table;
+    }
+
+    constexpr std::array<OpcodeInfo, opcode_count()> opcode_table = make_opcode_table();
+}
+
+const std::uint32_t native_opcode_count = opcode_count();
+
+const OpcodeInfo& opcode_info(std::uint32_t opcode)
+{
+    return opcode < opcode_table.size() ? opcode_table[opcode] : unknown_opcode;
+}
+
+const char* get_mnemonic(Bytecode bytecode)
+{
+    return opcode_info((std::uint32_t)bytecode).mnemonic;
+}
+
+bool is_known_opcode(std::uint32_t opcode)
+{
+    return opcode_info(opcode).flags & OPCODE_KNOWN;
+}
+
+DisassembleCallback get_disassemble_callback(std::uint32_t opcode)
+{
+    const OpcodeInfo& info = opcode_info(opcode);
+    if (info.flags & OPCODE_KNOWN)
+    {
+        return info.disassemble;
+    }
+    if (custom_operand_counts.find(opcode) != custom_operand_counts.end())
+    {
+        return dis_custom_operands;
     }
     return nullptr;
 }
+
+// ----------------------------------------------------------------------------
+// Operand names
+
+namespace
+{
+    template<typename T>
+    struct Name
+    {
+        T value;
+        const char* name;
+    };
+
+    constexpr Name<AccessModifier> modifier_list[] = {
+        { AccessModifier::SRC, "SRC" },
+        { AccessModifier::DOT, "DOT" },
+        { AccessModifier::ARG, "ARG" },
+        { AccessModifier::ARGS, "ARGS" },
+        { AccessModifier::LOCAL, "LOCAL" },
+        { AccessModifier::GLOBAL, "GLOBAL" },
+        { AccessModifier::SUBVAR, "SUBVAR" },
+        { AccessModifier::CACHE, "CACHE" },
+
+        { AccessModifier::SRC_PROC_SPEC, "SRC_PROC_SPEC" },
+        { AccessModifier::SRC_PROC, "SRC_PROC" },
+        { AccessModifier::PROC, "PROC" },
+        { AccessModifier::PROC_NO_RET, "PROC_NO_RET" },
+
+        { AccessModifier::WORLD, "WORLD" },
+        { AccessModifier::NULL_, "NULL" },
+    };
+
+    constexpr Name<DataType> datatype_list[] = {
+        { DataType::NULL_D, "NULL" },
+        { DataType::TURF, "TURF" },
+        { DataType::OBJ, "OBJ" },
+        { DataType::MOB, "MOB" },
+        { DataType::AREA, "AREA" },
+        { DataType::CLIENT, "CLIENT" },
+        { DataType::STRING, "STRING" },
+        { DataType::MOB_TYPEPATH, "MOB_TYPEPATH" },
+        { DataType::OBJ_TYPEPATH, "OBJ_TYPEPATH" },
+        { DataType::TURF_TYPEPATH, "TURF_TYPEPATH" },
+        { DataType::AREA_TYPEPATH, "AREA_TYPEPATH" },
+        { DataType::RESOURCE, "RESOURCE" },
+        { DataType::IMAGE, "IMAGE" },
+        { DataType::WORLD_D, "WORLD" },
+        { DataType::DATUM, "DATUM" },
+        { DataType::SAVEFILE, "SAVEFILE" },
+        { DataType::LIST_TYPEPATH, "LIST_TYPEPATH" },
+        { DataType::NUMBER, "NUMBER" },
+        { DataType::CLIENT_TYPEPATH, "CLIENT_TYPEPATH" },
+        { DataType::LIST, "LIST" },
+        { DataType::LIST_ARGS, "LIST_ARGS" },
+        { DataType::LIST_VERBS, "LIST_VERBS" },
+        { DataType::LIST_CONTENTS, "LIST_CONTENTS" },
+        { DataType::DATUM_TYPEPATH, "DATUM_TYPEPATH" },
+        { DataType::LIST_TURF_CONTENTS, "LIST_TURF_CONTENTS" },
+    };
+
+    const std::uint32_t FIRST_MODIFIER = (std::uint32_t)AccessModifier::SRC;
+    const std::uint32_t LAST_MODIFIER = (std::uint32_t)AccessModifier::INITIAL;
+
+    constexpr std::array<const char*, LAST_MODIFIER - FIRST_MODIFIER + 1> make_modifier_names()
+    {
+        std::array<const char*, LAST_MODIFIER - FIRST_MODIFIER + 1> names {};
+        for (const Name<AccessModifier>& entry : modifier_list)
+        {
+            names[(std::uint32_t)entry.value - FIRST_MODIFIER] = entry.name;
+        }
+        return names;
+    }
+
+    constexpr std::array<const char*, 0x100> make_datatype_names()
+    {
+        std::array<const char*, 0x100> names {};
+        for (const Name<DataType>& entry : datatype_list)
+        {
+            names[entry.value] = entry.name;
+        }
+        return names;
+    }
+
+    constexpr auto modifier_names = make_modifier_names();
+    constexpr auto datatype_names = make_datatype_names();
+}
+
+const char* modifier_name(std::uint32_t modifier)
+{
+    if (modifier < FIRST_MODIFIER || modifier > LAST_MODIFIER)
+    {
+        return nullptr;
+    }
+    return modifier_names[modifier - FIRST_MODIFIER];
+}
+
+const char* datatype_name(std::uint32_t type)
+{
+    return type < datatype_names.size() ? datatype_names[type] : nullptr;
+}
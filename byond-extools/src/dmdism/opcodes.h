@@ -43,58 +43,60 @@ enum class AccessModifier : std::uint32_t
 	INITIAL = 0xFFE7,
 };
 
-const std::unordered_map<AccessModifier, std::string> modifier_names = {
-	{AccessModifier::SRC, "SRC"},
-	{AccessModifier::DOT, "DOT" },
-	{AccessModifier::ARG, "ARG" },
-	{AccessModifier::ARGS, "ARGS"},
-	{AccessModifier::LOCAL, "LOCAL"},
-	{AccessModifier::GLOBAL, "GLOBAL"},
-	{AccessModifier::SUBVAR, "SUBVAR"},
-	{AccessModifier::CACHE, "CACHE"},
-
-	{AccessModifier::SRC_PROC_SPEC, "SRC_PROC_SPEC"},
-	{AccessModifier::SRC_PROC, "SRC_PROC"},
-	{AccessModifier::PROC, "PROC"},
-	{AccessModifier::PROC_NO_RET, "PROC_NO_RET"},
-
-	{AccessModifier::WORLD, "WORLD"},
-	{AccessModifier::NULL_, "NULL"},
-};
-
-const std::unordered_map<DataType, std::string> datatype_names = {
-	{ DataType::NULL_D, "NULL" },
-	{ DataType::TURF, "TURF" },
-	{ DataType::OBJ, "OBJ" },
-	{ DataType::MOB, "MOB" },
-	{ DataType::AREA, "AREA" },
-	{ DataType::CLIENT, "CLIENT" },
-	{ DataType::STRING, "STRING" },
-	{ DataType::MOB_TYPEPATH, "MOB_TYPEPATH" },
-	{ DataType::OBJ_TYPEPATH, "OBJ_TYPEPATH" },
-	{ DataType::TURF_TYPEPATH, "TURF_TYPEPATH" },
-	{ DataType::AREA_TYPEPATH, "AREA_TYPEPATH" },
-	{ DataType::RESOURCE, "RESOURCE"},
-	{ DataType::IMAGE, "IMAGE" },
-	{ DataType::WORLD_D, "WORLD" },
-	{ DataType::DATUM, "DATUM" },
-	{ DataType::SAVEFILE, "SAVEFILE" },
-	{ DataType::LIST_TYPEPATH, "LIST_TYPEPATH" },
-	{ DataType::NUMBER, "NUMBER" },
-	{ DataType::CLIENT_TYPEPATH, "CLIENT_TYPEPATH" },
-	{ DataType::LIST, "LIST" },
-	{ DataType::LIST_ARGS, "LIST_ARGS" },
-	{ DataType::LIST_VERBS, "LIST_VERBS" },
-	{ DataType::LIST_CONTENTS, "LIST_CONTENTS" },
-	{ DataType::DATUM_TYPEPATH, "DATUM_TYPEPATH" },
-	{ DataType::LIST_TURF_CONTENTS, "LIST_TURF_CONTENTS" },
-};
-
-const char* const get_mnemonic(Bytecode bytecode);
+// Names the disassembler prints for access modifiers and datatypes, nullptr for values that don't have one.
+const char* modifier_name(std::uint32_t modifier);
+const char* datatype_name(std::uint32_t type);
 
 class Instruction;
 class Context;
 class Disassembler;
 typedef void (*DisassembleCallback)(Instruction*, Context*, Disassembler*);
 
+// How an opcode's operands are laid out, as far as the decoder is concerned.
+enum class OperandShape : std::uint8_t
+{
+	ARGS, // `operands` plain words
+	VAR, // an access modifier and whatever follows it
+	ARGS_VAR, // `operands` plain words, then a var
+	JUMP, // a jump operand, then `operands` - 1 plain words
+	CALL, // a var, then the proc
+	PUSHVAL, // a datatype, then one word, or two for a number
+	SWITCH,
+	PICK_SWITCH,
+};
+
+enum OpcodeFlags : std::uint8_t
+{
+	OPCODE_KNOWN = 1, // in opcodes_table.inl
+	OPCODE_JUMP = 2, // has jump operands
+	OPCODE_CALL = 4, // calls a proc
+	OPCODE_TERMINATOR = 8, // never continues with the next instruction
+};
+
+// stack_effect for instructions whose effect depends on their operands, or that nobody has worked out yet.
+const std::int8_t STACK_VARIABLE = -128;
+
+struct OpcodeInfo
+{
+	const char* mnemonic;
+	DisassembleCallback disassemble;
+	OperandShape shape;
+	std::uint8_t operands;
+	std::int8_t stack_effect; // values pushed minus values popped
+	std::uint8_t flags;
+};
+
+// Everything known about an opcode, from a table generated at compile time from opcodes_table.inl.
+// Custom opcodes and anything else that isn't in the table get an entry without OPCODE_KNOWN.
+const OpcodeInfo& opcode_info(std::uint32_t opcode);
+
+const char* get_mnemonic(Bytecode bytecode);
+// One past the highest opcode in opcodes_table.inl.
+extern const std::uint32_t native_opcode_count;
+// False for custom opcodes and anything else that isn't in opcodes_table.inl.
+bool is_known_opcode(std::uint32_t opcode);
+// Lets the disassembler step over the operands of a custom opcode registered with Core::register_opcode.
+void set_custom_opcode_operands(std::uint32_t opcode, unsigned int count);
+bool custom_opcode_operands(std::uint32_t opcode, unsigned int& count);
+
 DisassembleCallback get_disassemble_callback(std::uint32_t opcode);
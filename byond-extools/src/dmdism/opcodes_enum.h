@@ -1,3 +1,5 @@
+#pragma once
+
 #include "opcodes.h"
 
 enum class Bytecode : uint32_t
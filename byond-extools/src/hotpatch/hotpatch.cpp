@@ -0,0 +1,253 @@
+#include "hotpatch.h"
+#include "../core/socket/socket.h"
+#include "../dmdism/decoder.h"
+#include "../dmdism/opcodes_enum.h"
+#include "../dmdism/helpers.h"
+
+#include <future>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+	struct Revision
+	{
+		std::vector<std::uint32_t> bytecode;
+		bool original; // BYOND's own bytecode, so rolling back to it is a reset_bytecode()
+	};
+}
+
+static std::unordered_map<std::uint32_t, std::vector<Revision>> revisions;
+
+bool Hotpatch::validate(Core::Proc& proc, const std::vector<std::uint32_t>& bytecode, std::string& error)
+{
+	if (bytecode.empty() || bytecode.size() > 0xFFFF)
+	{
+		error = "bytecode must be between 1 and 65535 words long";
+		return false;
+	}
+	std::vector<Core::Proc>& procs = Core::get_all_procs();
+	DecodedProc decoded;
+	decode(bytecode, decoded);
+	if (!decoded.complete)
+	{
+		error = "the last instruction is cut off";
+		return false;
+	}
+	VarOperand var;
+	std::vector<bool> starts(bytecode.size() + 1);
+	starts[bytecode.size()] = true;
+	for (const DecodedInstruction& instr : decoded.instructions)
+	{
+		if (!instr.known && !Core::opcode_handlers.count(instr.opcode))
+		{
+			error = "unknown opcode " + tohex(instr.opcode) + " at " + std::to_string(instr.offset);
+			return false;
+		}
+		if (instr.var_operand && decode_var(bytecode, instr.var_operand, var))
+		{
+			AccessModifier base = (AccessModifier)((AccessModifier)var.modifier == AccessModifier::SUBVAR ? var.base : var.modifier);
+			if (base == AccessModifier::LOCAL && var.id >= proc.get_local_count())
+			{
+				error = "local " + std::to_string(var.id) + " at " + std::to_string(instr.offset) + " doesn't exist, "
+					+ proc.name + " has " + std::to_string(proc.get_local_count());
+				return false;
+			}
+		}
+		if (instr.opcode == Bytecode::CALLGLOB && (instr.length != 3 || bytecode[instr.offset + 2] >= procs.size()))
+		{
+			error = "call to a proc that doesn't exist at " + std::to_string(instr.offset);
+			return false;
+		}
+		starts[instr.offset] = true;
+	}
+	for (const DecodedInstruction& instr : decoded.instructions)
+	{
+		for (std::size_t i = 0; i < instr.jump_count; i++)
+		{
+			std::uint16_t target = decoded.jump_target(bytecode, instr, i);
+			if (target > bytecode.size() || !starts[target])
+			{
+				error = "jump at " + std::to_string(instr.offset) + " lands inside an instruction";
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool Hotpatch::apply(std::vector<Patch>& patches, std::string& error)
+{
+	for (Patch& patch : patches)
+	{
+		if (!validate(*patch.proc, patch.bytecode, error))
+		{
+			error = patch.proc->name + ": " + error;
+			return false;
+		}
+	}
+	for (Patch& patch : patches)
+	{
+		Core::Proc& proc = *patch.proc;
+		std::uint32_t* current = proc.get_bytecode();
+		revisions[proc.id].push_back({ std::vector<std::uint32_t>(current, current + proc.get_bytecode_length()), !proc.original_bytecode_ptr });
+		proc.set_bytecode(std::move(patch.bytecode));
+	}
+	return true;
+}
+
+bool Hotpatch::rollback(Core::Proc& proc)
+{
+	auto ptr = revisions.find(proc.id);
+	if (ptr == revisions.end() || ptr->second.empty())
+	{
+		return false;
+	}
+	Revision& previous = ptr->second.back();
+	if (previous.original)
+	{
+		proc.reset_bytecode();
+	}
+	else
+	{
+		proc.set_bytecode(std::move(previous.bytecode));
+	}
+	ptr->second.pop_back();
+	return true;
+}
+
+nlohmann::json Hotpatch::history()
+{
+	std::vector<nlohmann::json> result;
+	for (auto& [id, list] : revisions)
+	{
+		if (!list.empty())
+		{
+			result.push_back({ {"proc", Core::get_proc(id).name}, {"revisions", list.size()} });
+		}
+	}
+	return result;
+}
+
+static Core::Proc* find_proc(const nlohmann::json& content)
+{
+	if (!content.is_object() || !content.contains("proc") || !content["proc"].is_string())
+	{
+		return nullptr;
+	}
+	return Core::try_get_proc(content["proc"].get<std::string>(), content.value("override_id", 0u));
+}
+
+// Runs on the main thread, between ticks.
+static nlohmann::json handle_request(const std::string& type, const nlohmann::json& content)
+{
+	std::string error;
+	if (type == MESSAGE_HOTPATCH)
+	{
+		std::vector<Hotpatch::Patch> patches;
+		for (const nlohmann::json& entry : content.value("procs", nlohmann::json::array()))
+		{
+			Core::Proc* proc = find_proc(entry);
+			if (!proc)
+			{
+				return { {"ok", false}, {"error", "unknown proc " + entry.value("proc", std::string())} };
+			}
+			patches.push_back({ proc, entry.at("bytecode").get<std::vector<std::uint32_t>>() });
+		}
+		if (!Hotpatch::apply(patches, error))
+		{
+			return { {"ok", false}, {"error", error} };
+		}
+		return { {"ok", true} };
+	}
+	if (type == MESSAGE_HOTPATCH_ROLLBACK)
+	{
+		Core::Proc* proc = find_proc(content);
+		if (!proc || !Hotpatch::rollback(*proc))
+		{
+			return { {"ok", false}, {"error", "nothing to roll back"} };
+		}
+		return { {"ok", true} };
+	}
+	if (type == MESSAGE_HOTPATCH_HISTORY)
+	{
+		return { {"ok", true}, {"procs", Hotpatch::history()} };
+	}
+	return { {"ok", false}, {"error", "unknown message type " + type} };
+}
+
+static void serve(JsonStream& client)
+{
+	while (true)
+	{
+		nlohmann::json message;
+		try
+		{
+			message = client.recv_message();
+		}
+		catch (const std::exception& e)
+		{
+			// The bad message has been consumed, so the stream can carry on after it.
+			if (!client.send("error", { {"ok", false}, {"error", std::string("invalid JSON: ") + e.what()} }))
+			{
+				return;
+			}
+			continue;
+		}
+		if (message.is_null())
+		{
+			return;
+		}
+		std::string type = message.value("type", std::string());
+		nlohmann::json content = message.value("content", nlohmann::json());
+
+		// The promise is owned by the job, so if the job gets dropped on cleanup the future reports it.
+		auto done = std::make_shared<std::promise<nlohmann::json>>();
+		std::future<nlohmann::json> response = done->get_future();
+		Core::run_between_ticks([done, type, content]() {
+			try
+			{
+				done->set_value(handle_request(type, content));
+			}
+			catch (const std::exception& e)
+			{
+				done->set_value({ {"ok", false}, {"error", e.what()} });
+			}
+		});
+		nlohmann::json result;
+		try
+		{
+			result = response.get();
+		}
+		catch (const std::future_error&)
+		{
+			result = { {"ok", false}, {"error", "extools was shut down"} };
+		}
+		if (!client.send(type.c_str(), result))
+		{
+			return;
+		}
+	}
+}
+
+bool Hotpatch::start_server(const char* port)
+{
+	JsonListener listener;
+	if (!listener.listen(port))
+	{
+		return false;
+	}
+	std::thread([listener = std::move(listener)]() mutable {
+		while (true)
+		{
+			JsonStream client = listener.accept();
+			if (!client.valid())
+			{
+				return;
+			}
+			serve(client);
+			client.close();
+		}
+	}).detach();
+	return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../core/core.h"
+#include "../third_party/json.hpp"
+
+#include <vector>
+
+const char* const HOTPATCH_DEFAULT_PORT = "2449";
+
+// The hotpatch protocol is the same null-separated stream of JSON messages the debugger uses.
+// Every request gets one response of the same type, with {"ok": bool} and an "error" string on failure.
+// A message that isn't valid JSON gets an "error" response, since its type can't be known.
+
+// content: {"procs": [{"proc": "/proc/foo", "override_id": 0, "bytecode": [...]}]}
+// All procs are patched together between two ticks, or none of them are.
+#define MESSAGE_HOTPATCH "hotpatch"
+// content: {"proc": "/proc/foo", "override_id": 0}
+#define MESSAGE_HOTPATCH_ROLLBACK "hotpatch rollback"
+// response content: a list of {"proc", "revisions"}
+#define MESSAGE_HOTPATCH_HISTORY "hotpatch history"
+
+namespace Hotpatch
+{
+	struct Patch
+	{
+		Core::Proc* proc;
+		std::vector<std::uint32_t> bytecode;
+	};
+
+	// Decodes the bytecode and checks that it decodes exactly, only uses known opcodes, jumps to the start of
+	// instructions, and only refers to locals and procs that exist.
+	bool validate(Core::Proc& proc, const std::vector<std::uint32_t>& bytecode, std::string& error);
+
+	// Validates every patch and then swaps all of them in, or leaves everything alone. The previous bytecode goes
+	// on the proc's rollback history. Frames already running the old code finish in it.
+	bool apply(std::vector<Patch>& patches, std::string& error);
+	// Puts back the bytecode a proc had before its last patch.
+	bool rollback(Core::Proc& proc);
+	nlohmann::json history();
+
+	// Starts a background thread that accepts patches on the given port and applies them between ticks.
+	// Core::hook_ticks() must have been called from the main thread.
+	bool start_server(const char* port);
+}
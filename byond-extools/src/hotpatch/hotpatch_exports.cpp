@@ -0,0 +1,40 @@
+#include "../core/core.h"
+#include "hotpatch.h"
+
+// Starts the hotpatch server. Argument: port to listen on, HOTPATCH_DEFAULT_PORT if missing.
+extern "C" EXPORT const char* hotpatch_initialize(int n_args, const char** args)
+{
+	if (!Core::initialize() || !Core::hook_ticks())
+	{
+		return Core::FAIL;
+	}
+	const char* port = n_args > 0 && *args[0] ? args[0] : HOTPATCH_DEFAULT_PORT;
+	return Hotpatch::start_server(port) ? Core::SUCCESS : Core::FAIL;
+}
+
+// Argument: proc path. Puts back the bytecode the proc had before its last patch.
+extern "C" EXPORT const char* hotpatch_rollback(int n_args, const char** args)
+{
+	if (!Core::initialize() || n_args < 1)
+	{
+		return Core::FAIL;
+	}
+	Core::Proc* proc = Core::try_get_proc(args[0]);
+	if (!proc || !Hotpatch::rollback(*proc))
+	{
+		return Core::FAIL;
+	}
+	return Core::SUCCESS;
+}
+
+// Returns the patched procs and how many revisions each can roll back, as JSON.
+extern "C" EXPORT const char* hotpatch_history(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return "";
+	}
+	result = Hotpatch::history().dump();
+	return result.c_str();
+}
@@ -0,0 +1,546 @@
+#include "indexer.h"
+#include "../core/core.h"
+#include "../core/parallel.h"
+#include "../dmdism/decoder.h"
+#include "../dmdism/opcodes.h"
+#include "../dmdism/opcodes_enum.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+	enum class Kind : std::uint8_t
+	{
+		CALL_PROC, // key is a proc id
+		CALL_NAME, // key is the string id of a proc name, for calls like src.foo() that only name the proc
+		READ, // key is the string id of a var name
+		WRITE,
+		STRING, // key is the string id of a literal
+	};
+
+	// The target doesn't depend on the type of an object: CALLGLOB, or a var of src accessed without a chain.
+	const std::uint8_t FLAG_STATIC = 1;
+
+	struct Reference
+	{
+		std::uint32_t key;
+		std::uint32_t proc_id;
+		std::uint16_t offset;
+		Kind kind;
+		std::uint8_t flags;
+	};
+	static_assert(sizeof(Reference) == 12, "Reference is written to the cache as is");
+
+	bool operator<(const Reference& a, const Reference& b)
+	{
+		return std::tie(a.kind, a.key, a.proc_id, a.offset) < std::tie(b.kind, b.key, b.proc_id, b.offset);
+	}
+
+	bool by_kind_and_key(const Reference& a, const Reference& b)
+	{
+		return std::tie(a.kind, a.key) < std::tie(b.kind, b.key);
+	}
+
+	struct Index
+	{
+		std::vector<Reference> by_proc; // in proc id and offset order
+		std::vector<std::uint32_t> proc_start; // by_proc[proc_start[id]] is the first reference in proc `id`
+		std::vector<Reference> by_key; // sorted, for lookups by what is referenced
+		std::unordered_map<std::uint32_t, std::string> names;
+		std::unordered_map<std::string, std::uint32_t> ids;
+		std::unordered_map<std::string, std::vector<std::uint32_t>> procs_by_name; // proc ids by simple_name
+	};
+
+	const std::uint8_t ACCESS_READ = 1;
+	const std::uint8_t ACCESS_WRITE = 2;
+
+	// Finds the references in a single instruction. Operands are only read inside the instruction, which the
+	// decoder has already measured, so a truncated last instruction reads zeroes instead of running off the end.
+	struct Collector
+	{
+		BytecodeView code;
+		std::uint32_t proc_id;
+		std::vector<Reference>& out;
+		std::uint16_t offset = 0;
+		std::size_t end = 0;
+		VarOperand operand; // reused for every var in the proc
+
+		std::uint32_t word(std::size_t pos) const
+		{
+			return pos < end ? code[pos] : 0;
+		}
+
+		void add(Kind kind, std::uint32_t key, std::uint8_t flags = 0)
+		{
+			out.push_back({ key, proc_id, offset, kind, flags });
+		}
+
+		void access(std::uint32_t name, std::uint8_t access, bool src)
+		{
+			std::uint8_t flags = src ? FLAG_STATIC : 0;
+			if (access & ACCESS_READ)
+			{
+				add(Kind::READ, name, flags);
+			}
+			if (access & ACCESS_WRITE)
+			{
+				add(Kind::WRITE, name, flags);
+			}
+		}
+
+		// Every link of a chain but the last is read, the last one gets `last`. A plain name is a var of src.
+		// Returns the offset of whatever follows the var.
+		std::size_t var(std::size_t pos, std::uint8_t last)
+		{
+			if (!decode_var(code, pos, operand) || operand.end > end)
+			{
+				return operand.end; // a proc reference, or cut off at the end of the bytecode
+			}
+			switch ((AccessModifier)operand.modifier)
+			{
+			case AccessModifier::SUBVAR:
+			{
+				bool src = (AccessModifier)operand.base == AccessModifier::SRC;
+				for (std::size_t i = 0; i < operand.chain.size(); i++)
+				{
+					access(operand.chain[i], i + 1 < operand.chain.size() ? ACCESS_READ : last, src && i == 0);
+				}
+				break;
+			}
+			case AccessModifier::LOCAL:
+			case AccessModifier::GLOBAL:
+			case AccessModifier::ARG:
+			case AccessModifier::INITIAL:
+			case AccessModifier::CACHE:
+			case AccessModifier::WORLD:
+			case AccessModifier::NULL_:
+			case AccessModifier::DOT:
+			case AccessModifier::SRC:
+			case AccessModifier::ARGS:
+				break;
+			default:
+				access(operand.modifier, last, true);
+				break;
+			}
+			return operand.end;
+		}
+
+		void instruction(const DecodedInstruction& instr)
+		{
+			offset = instr.offset;
+			end = instr.offset + instr.length;
+			switch ((Bytecode)instr.opcode)
+			{
+			case Bytecode::CALLGLOB:
+				add(Kind::CALL_PROC, word(offset + 2), FLAG_STATIC);
+				return;
+			case Bytecode::PUSHVAL:
+				if (word(offset + 1) == DataType::STRING)
+				{
+					add(Kind::STRING, word(offset + 2));
+				}
+				return;
+			case Bytecode::CALL:
+			case Bytecode::CALLNR:
+			{
+				std::size_t pos = var(instr.var_operand, ACCESS_READ);
+				switch ((AccessModifier)word(pos))
+				{
+				case AccessModifier::PROC_NO_RET:
+				case AccessModifier::PROC:
+					add(Kind::CALL_PROC, word(pos + 1));
+					break;
+				case AccessModifier::SRC_PROC:
+				case AccessModifier::SRC_PROC_SPEC:
+					add(Kind::CALL_NAME, word(pos + 1));
+					break;
+				default:
+					break;
+				}
+				return;
+			}
+			case Bytecode::GETVAR:
+				var(instr.var_operand, ACCESS_READ);
+				return;
+			case Bytecode::SETVAR:
+			case Bytecode::SETVAR_COPY:
+				var(instr.var_operand, ACCESS_WRITE);
+				return;
+			default:
+				// Augmented assignments, ++, -- and the icon procs that modify an icon in place.
+				if (instr.var_operand)
+				{
+					var(instr.var_operand, ACCESS_READ | ACCESS_WRITE);
+				}
+				return;
+			}
+		}
+	};
+
+	void collect(std::vector<Core::Proc>& procs, Index& index)
+	{
+		std::vector<std::vector<Reference>> found(procs.size());
+		Core::parallel_for(procs.size(), [&](std::size_t i) {
+			BytecodeView code(procs[i].get_bytecode(), procs[i].get_bytecode_length());
+			if (!code.data)
+			{
+				return;
+			}
+			DecodedProc decoded;
+			decode(code, decoded);
+			Collector collector { code, procs[i].id, found[i] };
+			for (const DecodedInstruction& instr : decoded.instructions)
+			{
+				collector.instruction(instr);
+			}
+		});
+		std::size_t total = 0;
+		for (const std::vector<Reference>& refs : found)
+		{
+			total += refs.size();
+		}
+		index.by_proc.reserve(total);
+		for (const std::vector<Reference>& refs : found)
+		{
+			index.by_proc.insert(index.by_proc.end(), refs.begin(), refs.end());
+		}
+	}
+
+	// Touches the string table, so this part stays on the main thread.
+	void resolve_names(Index& index)
+	{
+		for (const Reference& ref : index.by_proc)
+		{
+			if (ref.kind != Kind::CALL_PROC && !index.names.count(ref.key))
+			{
+				index.names.emplace(ref.key, Core::GetStringFromId(ref.key));
+			}
+		}
+	}
+
+	void finish(Index& index, const std::vector<Core::Proc>& procs)
+	{
+		std::size_t proc_count = procs.size();
+		index.proc_start.assign(proc_count + 1, 0);
+		for (const Reference& ref : index.by_proc)
+		{
+			index.proc_start[ref.proc_id + 1]++;
+		}
+		for (std::size_t i = 0; i < proc_count; i++)
+		{
+			index.proc_start[i + 1] += index.proc_start[i];
+		}
+		index.by_key = index.by_proc;
+		std::sort(index.by_key.begin(), index.by_key.end());
+		for (auto& [id, name] : index.names)
+		{
+			index.ids.emplace(name, id);
+		}
+		for (const Core::Proc& proc : procs)
+		{
+			index.procs_by_name[proc.simple_name].push_back(proc.id);
+		}
+	}
+
+	// FNV-1a over every proc path and every bytecode word. The string ids baked into the bytecode only mean the
+	// same thing in the same build, so this decides whether a saved index can be reused.
+	std::uint64_t hash_codebase(std::vector<Core::Proc>& procs)
+	{
+		std::uint64_t hash = 14695981039346656037ull;
+		auto mix = [&](std::uint32_t value) {
+			hash ^= value;
+			hash *= 1099511628211ull;
+		};
+		mix(procs.size());
+		for (Core::Proc& proc : procs)
+		{
+			for (char c : proc.raw_path)
+			{
+				mix((unsigned char)c);
+			}
+			std::uint32_t* code = proc.get_bytecode();
+			std::uint16_t length = code ? proc.get_bytecode_length() : 0;
+			mix(length);
+			for (std::uint16_t i = 0; i < length; i++)
+			{
+				mix(code[i]);
+			}
+		}
+		return hash;
+	}
+
+	struct CacheHeader
+	{
+		char magic[4];
+		std::uint32_t version;
+		std::uint64_t hash;
+		std::uint32_t references;
+		std::uint32_t names;
+	};
+
+	const std::uint32_t CACHE_VERSION = 1;
+
+	void save(const std::string& path, std::uint64_t hash, const Index& index)
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			return;
+		}
+		CacheHeader header { { 'X', 'R', 'E', 'F' }, CACHE_VERSION, hash, (std::uint32_t)index.by_proc.size(), (std::uint32_t)index.names.size() };
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)index.by_proc.data(), index.by_proc.size() * sizeof(Reference));
+		for (auto& [id, name] : index.names)
+		{
+			std::uint32_t length = name.size();
+			out.write((const char*)&id, sizeof(id));
+			out.write((const char*)&length, sizeof(length));
+			out.write(name.data(), length);
+		}
+	}
+
+	bool load(const std::string& path, std::uint64_t hash, std::size_t proc_count, Index& index)
+	{
+		std::ifstream in(path, std::ios::binary);
+		CacheHeader header;
+		if (!in || !in.read((char*)&header, sizeof(header)))
+		{
+			return false;
+		}
+		if (std::string(header.magic, 4) != "XREF" || header.version != CACHE_VERSION || header.hash != hash)
+		{
+			return false;
+		}
+		index.by_proc.resize(header.references);
+		if (!in.read((char*)index.by_proc.data(), header.references * sizeof(Reference)))
+		{
+			return false;
+		}
+		for (std::uint32_t i = 0; i < header.names; i++)
+		{
+			std::uint32_t id;
+			std::uint32_t length;
+			if (!in.read((char*)&id, sizeof(id)) || !in.read((char*)&length, sizeof(length)))
+			{
+				return false;
+			}
+			std::string name(length, '\0');
+			if (!in.read(name.data(), length))
+			{
+				return false;
+			}
+			index.names.emplace(id, std::move(name));
+		}
+		return std::all_of(index.by_proc.begin(), index.by_proc.end(), [&](const Reference& ref) {
+			return ref.proc_id < proc_count;
+		});
+	}
+
+	// "/obj/item" is a subtype of "/obj", and everything but /world and /client is a /datum.
+	bool is_subtype(const std::string& type, const std::string& parent)
+	{
+		if (parent == "/datum")
+		{
+			return !type.empty() && type != "/world" && type.rfind("/client", 0) != 0;
+		}
+		return type.rfind(parent, 0) == 0 && (type.size() == parent.size() || type[parent.size()] == '/');
+	}
+
+	// The type whose src a proc runs on, "" for global procs.
+	std::string owner_of(const Core::Proc& proc)
+	{
+		return proc.name.substr(0, proc.name.rfind('/'));
+	}
+}
+
+static std::shared_ptr<const Index> current_index;
+static std::mutex current_index_mutex;
+
+static std::shared_ptr<const Index> get_index()
+{
+	std::lock_guard<std::mutex> lock(current_index_mutex);
+	return current_index;
+}
+
+nlohmann::json Indexer::build(const std::string& cache_path)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::vector<Core::Proc>& procs = Core::get_all_procs();
+	std::uint64_t hash = hash_codebase(procs);
+
+	auto index = std::make_shared<Index>();
+	bool from_cache = !cache_path.empty() && load(cache_path, hash, procs.size(), *index);
+	if (!from_cache)
+	{
+		*index = Index();
+		collect(procs, *index);
+		resolve_names(*index);
+		if (!cache_path.empty())
+		{
+			save(cache_path, hash, *index);
+		}
+	}
+	finish(*index, procs);
+	{
+		std::lock_guard<std::mutex> lock(current_index_mutex);
+		current_index = index;
+	}
+	return {
+		{"procs", procs.size()},
+		{"references", index->by_proc.size()},
+		{"names", index->names.size()},
+		{"from_cache", from_cache},
+		{"ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()},
+	};
+}
+
+bool Indexer::ready()
+{
+	return get_index() != nullptr;
+}
+
+static nlohmann::json reference_json(const Core::Proc& proc, std::uint16_t offset, bool exact)
+{
+	return { {"proc", proc.name}, {"override_id", proc.override_id}, {"offset", offset}, {"exact", exact} };
+}
+
+static auto find_references(const Index& index, Kind kind, std::uint32_t key)
+{
+	return std::equal_range(index.by_key.begin(), index.by_key.end(), Reference { key, 0, 0, kind, 0 }, by_kind_and_key);
+}
+
+static std::vector<nlohmann::json> callers(const Index& index, const Core::Proc& callee)
+{
+	std::vector<nlohmann::json> result;
+	// Calls on an object name the first declaration of the proc but run whichever override the object has,
+	// so every proc with the same name may lead here.
+	if (auto same_name = index.procs_by_name.find(callee.simple_name); same_name != index.procs_by_name.end())
+	{
+		for (std::uint32_t proc_id : same_name->second)
+		{
+			auto [begin, end] = find_references(index, Kind::CALL_PROC, proc_id);
+			for (auto ref = begin; ref != end; ++ref)
+			{
+				result.push_back(reference_json(Core::get_proc(ref->proc_id), ref->offset, proc_id == callee.id && (ref->flags & FLAG_STATIC)));
+			}
+		}
+	}
+	if (auto name = index.ids.find(callee.simple_name); name != index.ids.end())
+	{
+		auto [begin, end] = find_references(index, Kind::CALL_NAME, name->second);
+		for (auto ref = begin; ref != end; ++ref)
+		{
+			result.push_back(reference_json(Core::get_proc(ref->proc_id), ref->offset, false));
+		}
+	}
+	return result;
+}
+
+static std::vector<nlohmann::json> callees(const Index& index, const Core::Proc& caller)
+{
+	std::vector<nlohmann::json> result;
+	for (std::uint32_t i = index.proc_start[caller.id]; i < index.proc_start[caller.id + 1]; i++)
+	{
+		const Reference& ref = index.by_proc[i];
+		if (ref.kind == Kind::CALL_PROC && ref.key < Core::get_all_procs().size())
+		{
+			result.push_back(reference_json(Core::get_proc(ref.key), ref.offset, ref.flags & FLAG_STATIC));
+		}
+		else if (ref.kind == Kind::CALL_NAME)
+		{
+			result.push_back({ {"proc", index.names.at(ref.key)}, {"override_id", 0}, {"offset", ref.offset}, {"exact", false} });
+		}
+	}
+	return result;
+}
+
+static std::vector<nlohmann::json> accesses(const Index& index, Kind kind, const std::string& subject)
+{
+	std::vector<nlohmann::json> result;
+	// "/obj/var/health" narrows accesses of src.health to procs of /obj and its subtypes.
+	std::string type;
+	std::string name = subject;
+	if (std::size_t var = subject.rfind("/var/"); var != std::string::npos)
+	{
+		type = subject.substr(0, var);
+		name = subject.substr(var + 5);
+	}
+	auto id = index.ids.find(name);
+	if (id == index.ids.end())
+	{
+		return result;
+	}
+	auto [begin, end] = find_references(index, kind, id->second);
+	for (auto ref = begin; ref != end; ++ref)
+	{
+		const Core::Proc& proc = Core::get_proc(ref->proc_id);
+		bool exact = ref->flags & FLAG_STATIC;
+		if (exact && !type.empty() && !is_subtype(owner_of(proc), type))
+		{
+			continue;
+		}
+		result.push_back(reference_json(proc, ref->offset, exact));
+	}
+	return result;
+}
+
+static std::vector<nlohmann::json> string_uses(const Index& index, const std::string& subject)
+{
+	std::vector<nlohmann::json> result;
+	auto [begin, end] = std::equal_range(index.by_key.begin(), index.by_key.end(), Reference { 0, 0, 0, Kind::STRING, 0 },
+		[](const Reference& a, const Reference& b) { return a.kind < b.kind; });
+	for (auto ref = begin; ref != end; ++ref)
+	{
+		const std::string& text = index.names.at(ref->key);
+		if (text.find(subject) == std::string::npos)
+		{
+			// Skip the rest of the uses of this literal.
+			ref = std::upper_bound(ref, end, *ref, by_kind_and_key) - 1;
+			continue;
+		}
+		nlohmann::json use = reference_json(Core::get_proc(ref->proc_id), ref->offset, true);
+		std::string printable = text;
+		// BYOND's text macros are stored as bytes that aren't valid UTF-8, and JSON needs UTF-8.
+		std::replace_if(printable.begin(), printable.end(), [](char c) { return (unsigned char)c >= 0x80; }, '?');
+		use["string"] = printable;
+		result.push_back(std::move(use));
+	}
+	return result;
+}
+
+nlohmann::json Indexer::query(const std::string& kind, const std::string& subject)
+{
+	std::shared_ptr<const Index> index = get_index();
+	if (!index)
+	{
+		return { {"error", "the index hasn't been built"} };
+	}
+	if (kind == "callers" || kind == "callees")
+	{
+		const Core::Proc* proc = Core::try_get_proc(subject);
+		if (!proc)
+		{
+			return { {"error", "unknown proc " + subject} };
+		}
+		return kind == "callers" ? callers(*index, *proc) : callees(*index, *proc);
+	}
+	if (kind == "readers")
+	{
+		return accesses(*index, Kind::READ, subject);
+	}
+	if (kind == "writers")
+	{
+		return accesses(*index, Kind::WRITE, subject);
+	}
+	if (kind == "strings")
+	{
+		return string_uses(*index, subject);
+	}
+	return { {"error", "unknown query " + kind} };
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "../third_party/json.hpp"
+
+#include <string>
+
+const char* const INDEXER_DEFAULT_CACHE = "extools_xref.bin";
+
+// A cross-reference database of the whole codebase: who calls which proc, who reads and writes which var name and
+// where each string literal is used. Building it decodes every proc on all cores; queries are lookups in sorted
+// arrays and are safe from any thread.
+namespace Indexer
+{
+	// Loads the index from `cache_path` if it was saved for identical bytecode, otherwise builds it and saves it
+	// there. An empty path skips the cache. Main thread only. Returns {procs, references, names, from_cache, ms}.
+	nlohmann::json build(const std::string& cache_path);
+	bool ready();
+
+	// kind is one of
+	//   "callers"  subject is a proc path, returns the call sites that may reach it
+	//   "callees"  subject is a proc path, returns what it calls
+	//   "readers"  subject is "name" or "/type/var/name", returns the instructions that read that var
+	//   "writers"  same, for assignments, augmented assignments and ++/--
+	//   "strings"  subject is text, returns the uses of every string literal containing it
+	// Each reference is {proc, override_id, offset, exact}. exact is false when the target is only known by name,
+	// like a call that dispatches on the type of an object or a var accessed through a chain like L.loc.health.
+	nlohmann::json query(const std::string& kind, const std::string& subject);
+}
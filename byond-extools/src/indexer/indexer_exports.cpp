@@ -0,0 +1,28 @@
+#include "../core/core.h"
+#include "indexer.h"
+
+// Argument: cache file, INDEXER_DEFAULT_CACHE if missing, "none" to neither load nor save one.
+// Returns build statistics as JSON.
+extern "C" EXPORT const char* xref_build(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return "";
+	}
+	std::string cache = n_args > 0 && *args[0] ? args[0] : INDEXER_DEFAULT_CACHE;
+	result = Indexer::build(cache == "none" ? "" : cache).dump();
+	return result.c_str();
+}
+
+// Arguments: query kind and subject, see Indexer::query. Returns a JSON list of references, or {"error"}.
+extern "C" EXPORT const char* xref_query(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize() || n_args < 2)
+	{
+		return "";
+	}
+	result = Indexer::query(args[0], args[1]).dump();
+	return result.c_str();
+}
@@ -5,22 +5,16 @@
 
 //#define MAPTICK_FAST_WRITE
 
-SendMapsPtr oSendMaps;
-
-void hSendMaps()
+void record_maptick(std::chrono::nanoseconds duration)
 {
-	auto start = std::chrono::high_resolution_clock::now();
-	oSendMaps();
-	auto end = std::chrono::high_resolution_clock::now();
 #ifdef MAPTICK_FAST_WRITE
-	Core::global_direct_set("internal_tick_usage", std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100000.0f);
+	Core::global_direct_set("internal_tick_usage", std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 100000.0f);
 #else
-	Value::Global().set("internal_tick_usage", std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 100000.0f);
+	Value::Global().set("internal_tick_usage", std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 100000.0f);
 #endif
 }
 
 bool enable_maptick()
 {
-	oSendMaps = Core::install_hook(SendMaps, hSendMaps);
-	return oSendMaps;
+	return Core::on_maptick(record_maptick);
 }
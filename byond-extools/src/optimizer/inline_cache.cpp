@@ -0,0 +1,245 @@
+#include "inline_cache.h"
+#include "../dmdism/opcodes_enum.h"
+
+#include <deque>
+
+namespace
+{
+	struct Link
+	{
+		std::uint32_t name;
+		int type_id = -1;
+		std::uint32_t slot = 0;
+	};
+
+	struct Site
+	{
+		std::uint32_t proc_id;
+		std::uint32_t offset; // of the GETVAR in the original bytecode
+		AccessModifier base;
+		std::uint32_t base_id;
+		std::vector<Link> links;
+		std::uint16_t getvar_length;
+		std::uint32_t cache_offset = UINT32_MAX; // of the cache opcode in the running bytecode, known once it runs
+		bool disabled = false;
+
+		std::uint64_t hits = 0;
+		std::uint64_t misses = 0;
+		std::uint64_t fallbacks = 0;
+	};
+}
+
+// A deque so handlers can hold on to a site while new ones are added.
+static std::deque<Site> sites;
+
+// A site that mostly falls back, say because the chain goes through atoms or built-in vars, pays for our opcode
+// dispatch on top of the GETVAR every time. After this many fallbacks, if they're over three quarters of the
+// visits, the site is overwritten with a JMP to its GETVAR, which BYOND runs natively.
+static const std::uint64_t DISABLE_AFTER_FALLBACKS = 256;
+
+static void disable(Site& site, ExecutionContext* ctx)
+{
+	site.disabled = true;
+	ctx->bytecode[ctx->current_opcode] = (std::uint32_t)Bytecode::JMP;
+	ctx->bytecode[ctx->current_opcode + 1] = ctx->current_opcode + Optimizer::INLINE_CACHE_LENGTH;
+}
+
+static bool resolve(RawDatum* datum, Link& link)
+{
+	for (std::uint32_t i = 0; i < (std::uint16_t)datum->len_vars; i++)
+	{
+		if (datum->vars[i].id == link.name)
+		{
+			link.type_id = datum->type_id;
+			link.slot = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void inline_cache_getvar(ExecutionContext* ctx)
+{
+	std::uint32_t site_id = ctx->bytecode[ctx->current_opcode + 1];
+	// A breakpoint set on a site before it was disabled puts the cache opcode back in front of the JMP's operand
+	// when it's removed. The GETVAR is still right behind it, so just run that.
+	if (site_id >= sites.size() || sites[site_id].disabled || sites[site_id].proc_id != (std::uint32_t)ctx->constants->proc_id ||
+		(sites[site_id].cache_offset != UINT32_MAX && sites[site_id].cache_offset != ctx->current_opcode))
+	{
+		ctx->current_opcode += 1;
+		return;
+	}
+	Site& site = sites[site_id];
+	site.cache_offset = ctx->current_opcode;
+	Value value;
+	switch (site.base)
+	{
+	case AccessModifier::LOCAL:
+		value = ctx->local_variables[site.base_id];
+		break;
+	case AccessModifier::ARG:
+		if (site.base_id >= (std::uint32_t)ctx->constants->arg_count)
+		{
+			goto fallback;
+		}
+		value = ctx->constants->args[site.base_id];
+		break;
+	default:
+		value = ctx->constants->src;
+		break;
+	}
+
+	{
+		bool missed = false;
+		for (Link& link : site.links)
+		{
+			if (value.type != DataType::DATUM)
+			{
+				goto fallback;
+			}
+			RawDatum* datum = Core::GetDatumPointerById(value.value);
+			if (!datum)
+			{
+				goto fallback;
+			}
+			if (datum->type_id != link.type_id || link.slot >= (std::uint16_t)datum->len_vars || datum->vars[link.slot].id != link.name)
+			{
+				if (!resolve(datum, link))
+				{
+					goto fallback;
+				}
+				missed = true;
+			}
+			value = datum->vars[link.slot].value;
+		}
+		missed ? site.misses++ : site.hits++;
+		if (value.type != DataType::NUMBER && value.type != DataType::NULL_D)
+		{
+			IncRefCount(value.type, value.value); // the stack owns a reference, same as what GETVAR pushes
+		}
+		ctx->stack[ctx->stack_size++] = value;
+		ctx->current_opcode += 1 + site.getvar_length; // the site id, then the whole GETVAR
+		return;
+	}
+
+fallback:
+	site.fallbacks++;
+	if (site.fallbacks >= DISABLE_AFTER_FALLBACKS && site.fallbacks * 4 > (site.hits + site.misses + site.fallbacks) * 3)
+	{
+		disable(site, ctx);
+	}
+	ctx->current_opcode += 1; // just the site id, the GETVAR runs next
+}
+
+static std::uint32_t cache_opcode()
+{
+	static const char* const name = "INLINE_CACHE_GETVAR";
+	if (auto ptr = Core::name_to_opcode.find(name); ptr != Core::name_to_opcode.end() && Core::opcode_handlers.count(ptr->second))
+	{
+		return ptr->second;
+	}
+	std::uint32_t opcode = Core::register_opcode(name, inline_cache_getvar);
+	set_custom_opcode_operands(opcode, 1);
+	return opcode;
+}
+
+bool Optimizer::make_inline_cache(Instruction& getvar, std::uint32_t proc_id, std::uint32_t& opcode, std::uint32_t& site_id)
+{
+	std::vector<std::uint32_t>& bytes = getvar.bytes();
+	if (!(getvar == Bytecode::GETVAR) || bytes.size() < 4 || (AccessModifier)bytes[1] != AccessModifier::SUBVAR)
+	{
+		return false;
+	}
+	Site site;
+	site.proc_id = proc_id;
+	site.offset = getvar.offset();
+	site.base = (AccessModifier)bytes[2];
+	site.base_id = 0;
+	site.getvar_length = bytes.size();
+	std::size_t i = 3;
+	switch (site.base)
+	{
+	case AccessModifier::LOCAL:
+	case AccessModifier::ARG:
+		site.base_id = bytes[i++];
+		break;
+	case AccessModifier::SRC:
+		break;
+	default:
+		return false;
+	}
+	// Every link but the last is prefixed with SUBVAR. Anything else, like CACHE, means a shape we don't handle.
+	while (i < bytes.size())
+	{
+		if ((AccessModifier)bytes[i] == AccessModifier::SUBVAR && i + 1 < bytes.size())
+		{
+			site.links.push_back({ bytes[i + 1] });
+			i += 2;
+		}
+		else if (i == bytes.size() - 1)
+		{
+			site.links.push_back({ bytes[i] });
+			i++;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	if (site.links.empty())
+	{
+		return false;
+	}
+	opcode = cache_opcode();
+	site_id = sites.size();
+	sites.push_back(std::move(site));
+	return true;
+}
+
+std::uint32_t Optimizer::inline_cache_count()
+{
+	return sites.size();
+}
+
+void Optimizer::drop_inline_caches(std::uint32_t count)
+{
+	if (count < sites.size())
+	{
+		sites.resize(count);
+	}
+}
+
+nlohmann::json Optimizer::inline_cache_stats()
+{
+	std::vector<nlohmann::json> result;
+	for (const Site& site : sites)
+	{
+		std::string chain;
+		for (const Link& link : site.links)
+		{
+			chain += "." + Core::GetStringFromId(link.name);
+		}
+		std::uint64_t total = site.hits + site.misses + site.fallbacks;
+		result.push_back({
+			{"proc", Core::get_proc(site.proc_id).name},
+			{"offset", site.offset},
+			{"chain", chain},
+			{"hits", site.hits},
+			{"misses", site.misses},
+			{"fallbacks", site.fallbacks},
+			{"hit_rate", total ? (double)site.hits / total : 0.0},
+			{"disabled", site.disabled},
+		});
+	}
+	return result;
+}
+
+void Optimizer::reset_inline_cache_stats()
+{
+	for (Site& site : sites)
+	{
+		site.hits = 0;
+		site.misses = 0;
+		site.fallbacks = 0;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../core/core.h"
+#include "../dmdism/instruction.h"
+#include "../third_party/json.hpp"
+
+namespace Optimizer
+{
+	// Inline caches for GETVARs that walk a SUBVAR chain, like "L.loc.name". Each link remembers the type of the
+	// datum it saw last and where the var sat in that datum's var list, so a repeat visit is a type compare and an
+	// array read instead of a GetVariable call. The cache opcode goes in front of the original GETVAR: on success it
+	// pushes the value and skips it, otherwise the GETVAR runs as usual.
+	//
+	// Datums only store vars that were changed from their initial value, and built-in vars aren't in that list at
+	// all, so chains through those always take the generic path, as do chains off atoms. inline_cache_stats() shows
+	// where that happens. A site that mostly takes it is replaced with a JMP over the site id to the GETVAR.
+
+	// Words inserted in front of the GETVAR: the cache opcode and a site id.
+	constexpr std::uint16_t INLINE_CACHE_LENGTH = 2;
+
+	// Sets up a cache site for the given GETVAR. Returns false if it doesn't read a SUBVAR chain off a local,
+	// an argument or src.
+	bool make_inline_cache(Instruction& getvar, std::uint32_t proc_id, std::uint32_t& opcode, std::uint32_t& site_id);
+	// Sites are numbered in the order they're made. If the bytecode they were made for is thrown away, the sites
+	// made since inline_cache_count() returned `count` are dropped again.
+	std::uint32_t inline_cache_count();
+	void drop_inline_caches(std::uint32_t count);
+
+	// Per-site hits (every link cached), misses (a link had to be looked up again), fallbacks (generic GETVAR)
+	// and whether the site was disabled for falling back too often.
+	nlohmann::json inline_cache_stats();
+	void reset_inline_cache_stats();
+}
@@ -0,0 +1,252 @@
+#include "intrinsics.h"
+#include "../core/parallel.h"
+#include "../dmdism/decoder.h"
+#include "../dmdism/opcodes_enum.h"
+
+#include <cmath>
+#include <map>
+
+namespace
+{
+	struct Intrinsic
+	{
+		std::uint32_t proc_id;
+		unsigned int arity;
+		Optimizer::IntrinsicFunction function;
+
+		std::uint64_t calls = 0;
+		std::uint64_t fallbacks = 0;
+	};
+
+	struct Site
+	{
+		std::uint32_t proc_id;
+		std::uint32_t* word; // the CALLGLOB opcode; replaced bytecode is never freed, so this stays valid
+	};
+
+	bool number_args(Value* args, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (args[i].type != DataType::NUMBER)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool hypotenuse(Value* args, Value& result)
+	{
+		if (!number_args(args, 4))
+		{
+			return false;
+		}
+		float dx = args[0].valuef - args[2].valuef;
+		float dy = args[1].valuef - args[3].valuef;
+		result = Value(std::sqrt(dx * dx + dy * dy));
+		return true;
+	}
+
+	bool clamp(Value* args, Value& result)
+	{
+		if (!number_args(args, 3))
+		{
+			return false;
+		}
+		result = Value(std::fmin(std::fmax(args[0].valuef, args[1].valuef), args[2].valuef));
+		return true;
+	}
+
+	bool lerp(Value* args, Value& result)
+	{
+		if (!number_args(args, 3))
+		{
+			return false;
+		}
+		result = Value(args[0].valuef + (args[1].valuef - args[0].valuef) * args[2].valuef);
+		return true;
+	}
+
+	bool sign(Value* args, Value& result)
+	{
+		if (!number_args(args, 1))
+		{
+			return false;
+		}
+		result = Value((float)((args[0].valuef > 0) - (args[0].valuef < 0)));
+		return true;
+	}
+
+	struct Builtin
+	{
+		unsigned int arity;
+		Optimizer::IntrinsicFunction function;
+	};
+
+	const std::map<std::string, Builtin> builtins = {
+		{ "hypotenuse", { 4, hypotenuse } }, // (x1, y1, x2, y2)
+		{ "clamp", { 3, clamp } }, // (value, low, high)
+		{ "lerp", { 3, lerp } }, // (a, b, t)
+		{ "sign", { 1, sign } },
+	};
+}
+
+static std::map<std::uint32_t, Intrinsic> intrinsics;
+// Indexed by proc id, so the handler doesn't have to search.
+static std::vector<Intrinsic*> intrinsic_by_proc;
+static std::vector<Site> installed_sites;
+
+static void intrinsic_call(ExecutionContext* ctx)
+{
+	std::uint32_t argc = ctx->bytecode[ctx->current_opcode + 1];
+	std::uint32_t proc_id = ctx->bytecode[ctx->current_opcode + 2];
+	Intrinsic& intrinsic = *intrinsic_by_proc[proc_id];
+	Value* args = ctx->stack + ctx->stack_size - argc;
+	Value result;
+	if (intrinsic.function(args, result))
+	{
+		intrinsic.calls++;
+	}
+	else
+	{
+		intrinsic.fallbacks++;
+		result = Core::get_proc(proc_id).call(std::vector<Value>(args, args + argc), ctx->constants->usr);
+	}
+	// The arguments belonged to the stack, same as with a real CALLGLOB.
+	for (std::uint32_t i = 0; i < argc; i++)
+	{
+		if (args[i].type != DataType::NUMBER && args[i].type != DataType::NULL_D)
+		{
+			DecRefCount(args[i].type, args[i].value);
+		}
+	}
+	ctx->stack_size -= argc;
+	ctx->stack[ctx->stack_size++] = result;
+	ctx->current_opcode += 2;
+}
+
+static std::uint32_t intrinsic_opcode()
+{
+	static const char* const name = "INTRINSIC_CALL";
+	if (auto ptr = Core::name_to_opcode.find(name); ptr != Core::name_to_opcode.end() && Core::opcode_handlers.count(ptr->second))
+	{
+		return ptr->second;
+	}
+	std::uint32_t opcode = Core::register_opcode(name, intrinsic_call);
+	set_custom_opcode_operands(opcode, 2);
+	return opcode;
+}
+
+bool Optimizer::register_intrinsic(std::string proc_path, unsigned int arity, IntrinsicFunction function)
+{
+	Core::Proc* proc = Core::try_get_proc(proc_path);
+	if (!proc || !function)
+	{
+		return false;
+	}
+	intrinsics[proc->id] = { proc->id, arity, function };
+	return true;
+}
+
+bool Optimizer::bind_builtin_intrinsic(std::string proc_path, std::string builtin)
+{
+	auto ptr = builtins.find(builtin);
+	if (ptr == builtins.end())
+	{
+		return false;
+	}
+	return register_intrinsic(proc_path, ptr->second.arity, ptr->second.function);
+}
+
+nlohmann::json Optimizer::install_intrinsics()
+{
+	uninstall_intrinsics();
+	std::vector<Core::Proc>& procs = Core::get_all_procs();
+	intrinsic_by_proc.assign(procs.size(), nullptr);
+	for (auto& [id, intrinsic] : intrinsics)
+	{
+		intrinsic_by_proc[id] = &intrinsic;
+	}
+	if (intrinsics.empty())
+	{
+		return { {"procs", 0}, {"call_sites", 0}, {"arity_mismatches", 0} };
+	}
+
+	// Decoding every proc is by far the slowest part and only reads the bytecode, so it runs on every core while
+	// the game thread waits. Patching happens afterwards, on this thread.
+	std::vector<std::vector<std::uint32_t>> matches(procs.size());
+	std::vector<std::uint32_t> mismatches(procs.size());
+	Core::parallel_for(procs.size(), [&](std::size_t i) {
+		Core::Proc& proc = procs[i];
+		BytecodeView code(proc.get_bytecode(), proc.get_bytecode_length());
+		if (!code.data || intrinsic_by_proc[proc.id]) // the intrinsic's own body stays as it is, it's the fallback
+		{
+			return;
+		}
+		DecodedProc decoded;
+		decode(code, decoded);
+		for (const DecodedInstruction& instr : decoded.instructions)
+		{
+			if (instr.opcode != Bytecode::CALLGLOB || instr.length != 3)
+			{
+				continue;
+			}
+			std::uint32_t proc_id = code[instr.offset + 2];
+			if (proc_id >= intrinsic_by_proc.size() || !intrinsic_by_proc[proc_id])
+			{
+				continue;
+			}
+			if (code[instr.offset + 1] != intrinsic_by_proc[proc_id]->arity)
+			{
+				mismatches[i]++;
+				continue;
+			}
+			matches[i].push_back(instr.offset);
+		}
+	});
+
+	std::uint32_t opcode = intrinsic_opcode();
+	std::uint32_t patched_procs = 0;
+	std::uint32_t arity_mismatches = 0;
+	for (std::size_t i = 0; i < procs.size(); i++)
+	{
+		arity_mismatches += mismatches[i];
+		if (matches[i].empty())
+		{
+			continue;
+		}
+		patched_procs++;
+		std::uint32_t* bytecode = procs[i].get_bytecode();
+		for (std::uint32_t offset : matches[i])
+		{
+			bytecode[offset] = opcode;
+			installed_sites.push_back({ procs[i].id, bytecode + offset });
+		}
+	}
+	return { {"procs", patched_procs}, {"call_sites", installed_sites.size()}, {"arity_mismatches", arity_mismatches} };
+}
+
+void Optimizer::uninstall_intrinsics()
+{
+	for (Site& site : installed_sites)
+	{
+		*site.word = (std::uint32_t)Bytecode::CALLGLOB;
+	}
+	installed_sites.clear();
+}
+
+nlohmann::json Optimizer::intrinsic_stats()
+{
+	std::vector<nlohmann::json> result;
+	for (auto& [id, intrinsic] : intrinsics)
+	{
+		result.push_back({
+			{"proc", Core::get_proc(id).name},
+			{"arity", intrinsic.arity},
+			{"calls", intrinsic.calls},
+			{"fallbacks", intrinsic.fallbacks},
+		});
+	}
+	return result;
+}
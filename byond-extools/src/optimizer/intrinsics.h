@@ -0,0 +1,30 @@
+#pragma once
+
+#include "../core/core.h"
+#include "../third_party/json.hpp"
+
+namespace Optimizer
+{
+	// Intrinsics replace calls to small DM helper procs with native code. The DM proc stays as the reference
+	// implementation: every "CALLGLOB argc proc" to it is overwritten with a custom opcode that takes the arguments
+	// straight off the stack, so the call no longer needs a CallGlobalProc frame. The instruction keeps its length
+	// and operands, which means nothing else in the proc has to move.
+
+	// Computes the result from `arity` arguments. The arguments are borrowed, the result is owned by the caller.
+	// Return false to run the DM proc instead, for example when an argument isn't a number.
+	typedef bool(*IntrinsicFunction)(Value* args, Value& result);
+
+	// Only calls with exactly `arity` positional arguments are replaced. Returns false if the proc doesn't exist.
+	bool register_intrinsic(std::string proc_path, unsigned int arity, IntrinsicFunction function);
+	// Registers one of the intrinsics that ship with extools ("hypotenuse", "clamp", "lerp" or "sign") for a DM proc.
+	bool bind_builtin_intrinsic(std::string proc_path, std::string builtin);
+
+	// Scans every proc for calls to registered intrinsics and patches them. Returns how many procs and call sites
+	// were patched. Run it after the optimizer, which leaves procs with custom opcodes alone.
+	nlohmann::json install_intrinsics();
+	// Writes the original CALLGLOBs back.
+	void uninstall_intrinsics();
+
+	// Per-intrinsic native calls and fallbacks to the DM proc.
+	nlohmann::json intrinsic_stats();
+}
@@ -0,0 +1,596 @@
+#include "optimizer.h"
+#include "superinstructions.h"
+#include "inline_cache.h"
+#include "../dmdism/assembler.h"
+#include "../dmdism/decoder.h"
+#include "../dmdism/opcodes_enum.h"
+
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// Procs run straight out of these buffers, see Core::Proc::use_bytecode. Reverted ones are retired rather than
+// freed, since frames may still be running in them.
+static std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> optimized_bytecode;
+static std::vector<std::vector<std::uint32_t>> retired_optimized_bytecode;
+
+namespace
+{
+	struct Node
+	{
+		Instruction instr;
+		std::vector<std::size_t> targets {}; // indices into the node list, parallel to instr.jump_locations()
+		std::vector<Instruction> before {}; // inserted instructions, jumps to this node land on the first of them
+		bool removed = false;
+	};
+
+	typedef std::vector<Node> Nodes;
+
+	// Everything here either has an operand that encodes an offset we don't relocate, or an operand layout
+	// the disassembler doesn't know yet. Procs using them are left alone.
+	bool relocatable(std::uint32_t opcode)
+	{
+		switch ((Bytecode)opcode)
+		{
+		case Bytecode::LINK:
+		case Bytecode::EMPTYLIST:
+		case Bytecode::VIEW:
+		case Bytecode::OVIEW:
+		case Bytecode::VIEW_TARGET:
+		case Bytecode::OVIEW_TARGET:
+		case Bytecode::SPAWN:
+		case Bytecode::SWITCH_RANGE:
+		case Bytecode::FOR_RANGE:
+			return false;
+		default:
+			return is_known_opcode(opcode);
+		}
+	}
+
+	bool is_terminator(Instruction& instr)
+	{
+		return instr == Bytecode::RET || instr == Bytecode::END || instr == Bytecode::JMP;
+	}
+
+	std::size_t next_live(const Nodes& nodes, std::size_t i)
+	{
+		while (i < nodes.size() && nodes[i].removed)
+		{
+			i++;
+		}
+		return i;
+	}
+
+	bool number_constant(Instruction& instr, float& out)
+	{
+		std::vector<std::uint32_t>& bytes = instr.bytes();
+		if (instr == Bytecode::PUSHVAL && bytes.size() == 4 && bytes[1] == DataType::NUMBER)
+		{
+			std::uint32_t bits = bytes[2] << 16 | bytes[3];
+			std::memcpy(&out, &bits, sizeof(out));
+			return true;
+		}
+		if (instr == Bytecode::PUSHI && bytes.size() == 2)
+		{
+			out = (float)(std::int32_t)bytes[1];
+			return true;
+		}
+		return false;
+	}
+
+	Instruction make_number(float value)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		Instruction instr(Bytecode::PUSHVAL);
+		instr.add_byte(DataType::NUMBER);
+		instr.add_byte(bits >> 16);
+		instr.add_byte(bits & 0xFFFF);
+		return instr;
+	}
+
+	bool build_nodes(const std::vector<std::uint32_t>& bytecode, Nodes& nodes)
+	{
+		DecodedProc decoded;
+		decode(bytecode, decoded);
+		if (!decoded.complete)
+		{
+			return false; // the last instruction reads past the end
+		}
+		std::vector<std::int32_t> index_of(bytecode.size() + 1, -1);
+		for (std::size_t i = 0; i < decoded.instructions.size(); i++)
+		{
+			if (!relocatable(decoded.instructions[i].opcode))
+			{
+				return false;
+			}
+			index_of[decoded.instructions[i].offset] = i;
+		}
+		index_of[bytecode.size()] = decoded.instructions.size();
+
+		nodes.reserve(decoded.instructions.size());
+		for (std::size_t i = 0; i < decoded.instructions.size(); i++)
+		{
+			Node node { decoded.instruction(bytecode, i) };
+			for (unsigned short jump : node.instr.jump_locations())
+			{
+				if (jump > bytecode.size() || index_of[jump] < 0)
+				{
+					return false; // jumps into the middle of an instruction, so we decoded something wrong
+				}
+				node.targets.push_back(index_of[jump]);
+			}
+			nodes.push_back(std::move(node));
+		}
+		return true;
+	}
+
+	// Jumps that land on a JMP can go straight to its destination, and a JMP to the next instruction does nothing.
+	bool collapse_jumps(Nodes& nodes, Optimizer::Stats& stats)
+	{
+		bool changed = false;
+		for (Node& node : nodes)
+		{
+			if (node.removed)
+			{
+				continue;
+			}
+			for (std::size_t& target : node.targets)
+			{
+				std::size_t destination = next_live(nodes, target);
+				std::size_t hops = 0;
+				while (destination < nodes.size() && nodes[destination].instr == Bytecode::JMP && hops < nodes.size())
+				{
+					destination = next_live(nodes, nodes[destination].targets[0]);
+					hops++;
+				}
+				if (hops)
+				{
+					target = destination;
+					stats.jumps_collapsed++;
+					changed = true;
+				}
+			}
+		}
+		for (std::size_t i = 0; i < nodes.size(); i++)
+		{
+			Node& node = nodes[i];
+			if (!node.removed && node.instr == Bytecode::JMP && next_live(nodes, node.targets[0]) == next_live(nodes, i + 1))
+			{
+				node.removed = true;
+				stats.jumps_collapsed++;
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	bool remove_dead_code(Nodes& nodes, Optimizer::Stats& stats)
+	{
+		std::vector<bool> reachable(nodes.size());
+		std::vector<std::size_t> pending = { next_live(nodes, 0) };
+		while (!pending.empty())
+		{
+			std::size_t i = pending.back();
+			pending.pop_back();
+			if (i >= nodes.size() || reachable[i])
+			{
+				continue;
+			}
+			reachable[i] = true;
+			for (std::size_t target : nodes[i].targets)
+			{
+				pending.push_back(next_live(nodes, target));
+			}
+			if (!is_terminator(nodes[i].instr))
+			{
+				pending.push_back(next_live(nodes, i + 1));
+			}
+		}
+
+		bool changed = false;
+		// The final instruction stays, whatever it is, so execution can never run off the end.
+		for (std::size_t i = 0; i + 1 < nodes.size(); i++)
+		{
+			if (!nodes[i].removed && !reachable[i])
+			{
+				nodes[i].removed = true;
+				stats.dead_instructions++;
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	bool fold_constants(Nodes& nodes, Optimizer::Stats& stats)
+	{
+		std::vector<bool> targeted(nodes.size() + 1);
+		for (Node& node : nodes)
+		{
+			if (!node.removed)
+			{
+				for (std::size_t target : node.targets)
+				{
+					targeted[next_live(nodes, target)] = true;
+				}
+			}
+		}
+
+		bool changed = false;
+		for (std::size_t a = 0; a < nodes.size(); a++)
+		{
+			float x, y;
+			if (nodes[a].removed || !number_constant(nodes[a].instr, x))
+			{
+				continue;
+			}
+			// Neither of the instructions we fold away may be a jump target, or we would change what the jump sees.
+			std::size_t b = next_live(nodes, a + 1);
+			if (b >= nodes.size() || targeted[b])
+			{
+				continue;
+			}
+			if (nodes[b].instr == Bytecode::ANEG)
+			{
+				nodes[a].instr = make_number(-x);
+				nodes[b].removed = true;
+				stats.constants_folded++;
+				changed = true;
+				continue;
+			}
+			std::size_t c = next_live(nodes, b + 1);
+			if (c >= nodes.size() || targeted[c] || !number_constant(nodes[b].instr, y))
+			{
+				continue;
+			}
+			float result;
+			switch (nodes[c].instr.opcode().opcode())
+			{
+			case Bytecode::ADD:
+				result = x + y;
+				break;
+			case Bytecode::SUB:
+				result = x - y;
+				break;
+			case Bytecode::MUL:
+				result = x * y;
+				break;
+			case Bytecode::DIV:
+				if (y == 0.0f)
+				{
+					continue; // leave the runtime error to BYOND
+				}
+				result = x / y;
+				break;
+			default:
+				continue;
+			}
+			if (!std::isfinite(result))
+			{
+				continue;
+			}
+			nodes[a].instr = make_number(result);
+			nodes[b].removed = true;
+			nodes[c].removed = true;
+			stats.constants_folded++;
+			changed = true;
+		}
+		return changed;
+	}
+
+	bool strip_line_runs(Nodes& nodes, Optimizer::Stats& stats)
+	{
+		bool changed = false;
+		for (std::size_t i = 0; i < nodes.size(); i++)
+		{
+			if (nodes[i].removed || !(nodes[i].instr == Bytecode::DBG_LINENO))
+			{
+				continue;
+			}
+			std::size_t next = next_live(nodes, i + 1);
+			if (next < nodes.size() && nodes[next].instr == Bytecode::DBG_LINENO)
+			{
+				nodes[i].removed = true; // anything jumping here lands on the next line marker instead
+				stats.line_markers++;
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	bool local_access(Instruction& instr, Bytecode op, std::uint32_t& slot)
+	{
+		std::vector<std::uint32_t>& bytes = instr.bytes();
+		if (instr == op && bytes.size() == 3 && (AccessModifier)bytes[1] == AccessModifier::LOCAL)
+		{
+			slot = bytes[2];
+			return true;
+		}
+		return false;
+	}
+
+	// Finds "GETVAR LOCAL m; GETVAR LOCAL n; <op>; SETVAR LOCAL x" and puts a custom opcode in front of it. If the
+	// handler's type guard fails it does nothing and the original sequence runs, otherwise it skips over it.
+	bool add_superinstructions(Nodes& nodes, Optimizer::Stats& stats)
+	{
+		bool changed = false;
+		for (std::size_t a = 0; a < nodes.size(); a++)
+		{
+			std::uint32_t m, n, x;
+			if (nodes[a].removed || !local_access(nodes[a].instr, Bytecode::GETVAR, m))
+			{
+				continue;
+			}
+			std::size_t b = next_live(nodes, a + 1);
+			std::size_t op = next_live(nodes, b + 1);
+			std::size_t c = next_live(nodes, op + 1);
+			if (c >= nodes.size() || !nodes[b].before.empty() || !nodes[op].before.empty() || !nodes[c].before.empty())
+			{
+				continue;
+			}
+			if (!local_access(nodes[b].instr, Bytecode::GETVAR, n) || !local_access(nodes[c].instr, Bytecode::SETVAR, x))
+			{
+				continue;
+			}
+			std::uint32_t super_opcode = Optimizer::local_arithmetic_opcode(nodes[op].instr.opcode().opcode(), m, n, x);
+			if (!super_opcode)
+			{
+				continue;
+			}
+			nodes[a].before.push_back(Instruction(super_opcode));
+			stats.superinstructions++;
+			changed = true;
+			a = c;
+		}
+		return changed;
+	}
+
+	bool add_inline_caches(Nodes& nodes, std::uint32_t proc_id, Optimizer::Stats& stats)
+	{
+		bool changed = false;
+		for (Node& node : nodes)
+		{
+			std::uint32_t opcode, site_id;
+			if (node.removed || !node.before.empty() || !Optimizer::make_inline_cache(node.instr, proc_id, opcode, site_id))
+			{
+				continue;
+			}
+			Instruction cache(opcode);
+			cache.add_byte(site_id);
+			node.before.push_back(std::move(cache));
+			stats.inline_caches++;
+			changed = true;
+		}
+		return changed;
+	}
+
+	std::vector<std::uint32_t> emit(Nodes& nodes, std::size_t& instruction_count)
+	{
+		std::size_t words = 0;
+		for (Node& node : nodes)
+		{
+			for (Instruction& inserted : node.before)
+			{
+				words += inserted.size();
+			}
+			words += node.removed ? 0 : node.instr.size();
+		}
+		std::vector<std::uint32_t> result;
+		result.reserve(words);
+		Assembler assembler(result);
+
+		// Every node gets a label, bound before its inserted instructions. A removed node's label ends up on the
+		// next live one, which is exactly where jumps to it should go.
+		std::vector<Label> labels(nodes.size() + 1);
+		for (Label& label : labels)
+		{
+			label = assembler.label();
+		}
+		std::vector<Label> targets;
+		instruction_count = 0;
+		for (std::size_t i = 0; i < nodes.size(); i++)
+		{
+			Node& node = nodes[i];
+			assembler.bind(labels[i]);
+			for (Instruction& inserted : node.before)
+			{
+				assembler.instruction(inserted);
+				instruction_count++;
+			}
+			if (node.removed)
+			{
+				continue;
+			}
+			targets.clear();
+			for (std::size_t target : node.targets)
+			{
+				targets.push_back(labels[target]);
+			}
+			assembler.instruction(node.instr, targets.data());
+			instruction_count++;
+		}
+		assembler.bind(labels[nodes.size()]);
+		if (!assembler.finish())
+		{
+			result.clear(); // too long, verify() turns this down
+		}
+		return result;
+	}
+
+	bool verify(const std::vector<std::uint32_t>& bytecode, std::size_t expected_count)
+	{
+		if (bytecode.size() > 0xFFFF)
+		{
+			return false; // offsets are 16 bits
+		}
+		DecodedProc decoded;
+		decode(bytecode, decoded);
+		if (!decoded.complete || decoded.instructions.size() != expected_count)
+		{
+			return false;
+		}
+		std::vector<bool> starts(bytecode.size() + 1);
+		for (const DecodedInstruction& instr : decoded.instructions)
+		{
+			starts[instr.offset] = true;
+		}
+		starts[bytecode.size()] = true;
+		for (std::uint32_t operand : decoded.jump_operands)
+		{
+			if (bytecode[operand] > bytecode.size() || !starts[bytecode[operand]])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+nlohmann::json Optimizer::Stats::to_json() const
+{
+	return {
+		{"procs_optimized", procs_optimized},
+		{"procs_unchanged", procs_unchanged},
+		{"procs_rejected", procs_rejected},
+		{"constants_folded", constants_folded},
+		{"jumps_collapsed", jumps_collapsed},
+		{"dead_instructions", dead_instructions},
+		{"line_markers", line_markers},
+		{"superinstructions", superinstructions},
+		{"inline_caches", inline_caches},
+		{"words_saved", words_saved},
+	};
+}
+
+Optimizer::Result Optimizer::optimize(std::vector<std::uint32_t>& bytecode, const Options& options, Stats& stats, std::uint32_t proc_id)
+{
+	if (bytecode.empty())
+	{
+		stats.procs_unchanged++;
+		return Result::UNCHANGED;
+	}
+	Nodes nodes;
+	if (!build_nodes(bytecode, nodes) || nodes.size() >= 0xFFFF)
+	{
+		stats.procs_rejected++;
+		return Result::REJECTED;
+	}
+
+	Stats local;
+	std::uint32_t first_cache_site = inline_cache_count();
+	bool changed = true;
+	bool changed_any = false;
+	for (int pass = 0; changed && pass < 16; pass++)
+	{
+		changed = false;
+		if (options.collapse_jumps)
+			changed |= collapse_jumps(nodes, local);
+		if (options.remove_dead_code)
+			changed |= remove_dead_code(nodes, local);
+		if (options.fold_constants)
+			changed |= fold_constants(nodes, local);
+		if (options.strip_line_runs)
+			changed |= strip_line_runs(nodes, local);
+		changed_any |= changed;
+	}
+	// Runs last, the other passes don't know how to look past inserted instructions.
+	if (options.superinstructions)
+	{
+		changed_any |= add_superinstructions(nodes, local);
+	}
+	if (options.inline_caches)
+	{
+		changed_any |= add_inline_caches(nodes, proc_id, local);
+	}
+	if (!changed_any)
+	{
+		stats.procs_unchanged++;
+		return Result::UNCHANGED;
+	}
+
+	std::size_t instruction_count;
+	std::vector<std::uint32_t> result = emit(nodes, instruction_count);
+	if (!verify(result, instruction_count))
+	{
+		drop_inline_caches(first_cache_site);
+		stats.procs_rejected++;
+		return Result::REJECTED;
+	}
+
+	stats.procs_optimized++;
+	stats.constants_folded += local.constants_folded;
+	stats.jumps_collapsed += local.jumps_collapsed;
+	stats.dead_instructions += local.dead_instructions;
+	stats.line_markers += local.line_markers;
+	stats.superinstructions += local.superinstructions;
+	stats.inline_caches += local.inline_caches;
+	stats.words_saved += (std::int32_t)bytecode.size() - (std::int32_t)result.size();
+	bytecode = std::move(result);
+	return Result::OPTIMIZED;
+}
+
+Optimizer::Result Optimizer::optimize_proc(Core::Proc& proc, const Options& options, Stats& stats)
+{
+	if (proc.original_bytecode_ptr)
+	{
+		// Something else already replaced this proc's bytecode, most likely with a custom opcode stub.
+		stats.procs_rejected++;
+		return Result::REJECTED;
+	}
+	std::uint32_t* bytecode = proc.get_bytecode();
+	std::vector<std::uint32_t> code(bytecode, bytecode + (bytecode ? proc.get_bytecode_length() : 0));
+	Result result = optimize(code, options, stats, proc.id);
+	if (result == Result::OPTIMIZED)
+	{
+		std::vector<std::uint32_t>& stored = optimized_bytecode[proc.id];
+		if (!stored.empty())
+		{
+			retired_optimized_bytecode.push_back(std::move(stored));
+		}
+		stored = std::move(code);
+		proc.use_bytecode(stored.data(), stored.size());
+	}
+	return result;
+}
+
+bool Optimizer::use_original(Core::Proc& proc)
+{
+	if (optimized_bytecode.find(proc.id) == optimized_bytecode.end())
+	{
+		return false;
+	}
+	proc.reset_bytecode();
+	return true;
+}
+
+bool Optimizer::use_optimized(Core::Proc& proc)
+{
+	auto ptr = optimized_bytecode.find(proc.id);
+	if (ptr == optimized_bytecode.end())
+	{
+		return false;
+	}
+	proc.use_bytecode(ptr->second.data(), ptr->second.size());
+	return true;
+}
+
+void Optimizer::revert(Core::Proc& proc)
+{
+	if (use_original(proc))
+	{
+		auto ptr = optimized_bytecode.find(proc.id);
+		retired_optimized_bytecode.push_back(std::move(ptr->second));
+		optimized_bytecode.erase(ptr);
+	}
+}
+
+void Optimizer::revert_all()
+{
+	for (auto& [id, code] : optimized_bytecode)
+	{
+		Core::Proc& proc = Core::get_proc(id);
+		proc.reset_bytecode();
+		retired_optimized_bytecode.push_back(std::move(code));
+	}
+	optimized_bytecode.clear();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../core/core.h"
+#include "../third_party/json.hpp"
+
+#include <vector>
+
+namespace Optimizer
+{
+	struct Options
+	{
+		bool fold_constants = true;
+		bool collapse_jumps = true;
+		bool remove_dead_code = true;
+		// Drops every DBG_LINENO that is immediately followed by another one. Runtime errors still report the
+		// right line, but the debugger can no longer put a breakpoint on the removed lines, so only use it on hot procs.
+		bool strip_line_runs = false;
+		// Replaces "local = local <op> local" on numbers with a single native handler, see superinstructions.h.
+		bool superinstructions = true;
+		// Puts an inline cache in front of every GETVAR that walks a SUBVAR chain, see inline_cache.h. Each site
+		// costs a little on a miss, so like strip_line_runs this is meant for hot procs.
+		bool inline_caches = false;
+	};
+
+	struct Stats
+	{
+		std::uint32_t procs_optimized = 0;
+		std::uint32_t procs_unchanged = 0;
+		std::uint32_t procs_rejected = 0;
+		std::uint32_t constants_folded = 0;
+		std::uint32_t jumps_collapsed = 0;
+		std::uint32_t dead_instructions = 0;
+		std::uint32_t line_markers = 0;
+		std::uint32_t superinstructions = 0;
+		std::uint32_t inline_caches = 0;
+		std::int32_t words_saved = 0; // negative if folding grew the proc
+
+		nlohmann::json to_json() const;
+	};
+
+	enum class Result
+	{
+		UNCHANGED,
+		OPTIMIZED,
+		REJECTED, // the proc uses something we can't relocate, or the output didn't disassemble cleanly
+	};
+
+	// Rewrites the bytecode in place. Jump and switch targets are relocated, and the output is disassembled
+	// again and checked before it is accepted. On REJECTED the bytecode is left untouched.
+	// `proc_id` is only used to label inline cache sites.
+	Result optimize(std::vector<std::uint32_t>& bytecode, const Options& options, Stats& stats, std::uint32_t proc_id = 0);
+	Result optimize_proc(Core::Proc& proc, const Options& options, Stats& stats);
+
+	// Switches a proc between its original and optimized bytecode, so DM can call both and compare the results.
+	bool use_original(Core::Proc& proc);
+	bool use_optimized(Core::Proc& proc);
+	void revert(Core::Proc& proc);
+	void revert_all();
+}
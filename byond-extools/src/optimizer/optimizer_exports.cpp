@@ -0,0 +1,182 @@
+#include "../core/core.h"
+#include "optimizer.h"
+#include "inline_cache.h"
+#include "intrinsics.h"
+
+#include <unordered_set>
+
+static void collect_procs(const nlohmann::json& paths, std::unordered_set<std::uint32_t>& out)
+{
+	if (!paths.is_array())
+	{
+		return;
+	}
+	for (const nlohmann::json& path : paths)
+	{
+		if (!path.is_string())
+		{
+			continue;
+		}
+		if (Core::Proc* proc = Core::try_get_proc(path.get<std::string>()))
+		{
+			out.insert(proc->id);
+		}
+	}
+}
+
+// Runs the peephole optimizer, meant to be called once at startup.
+// Argument: a JSON object with optional "procs" (proc paths, every proc if missing), "hot" (procs that also
+// lose redundant line markers and get inline caches for SUBVAR reads) and "passes" ({"fold": bool, "jumps": bool, "dead_code": bool, "superinstructions": bool}).
+// Returns statistics as JSON.
+extern "C" EXPORT const char* optimizer_initialize(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return Core::FAIL;
+	}
+	nlohmann::json config = n_args > 0 ? nlohmann::json::parse(args[0], nullptr, false) : nlohmann::json::object();
+	if (!config.is_object())
+	{
+		config = nlohmann::json::object();
+	}
+
+	Optimizer::Options options;
+	nlohmann::json passes = config.value("passes", nlohmann::json::object());
+	if (passes.is_object())
+	{
+		options.fold_constants = passes.value("fold", true);
+		options.collapse_jumps = passes.value("jumps", true);
+		options.remove_dead_code = passes.value("dead_code", true);
+		options.superinstructions = passes.value("superinstructions", true);
+	}
+
+	std::unordered_set<std::uint32_t> hot;
+	collect_procs(config.value("hot", nlohmann::json()), hot);
+
+	Optimizer::Stats stats;
+	auto run = [&](Core::Proc& proc) {
+		Optimizer::Options proc_options = options;
+		proc_options.strip_line_runs = proc_options.inline_caches = hot.count(proc.id) > 0;
+		Optimizer::optimize_proc(proc, proc_options, stats);
+	};
+	if (config.contains("procs"))
+	{
+		std::unordered_set<std::uint32_t> selected = hot;
+		collect_procs(config["procs"], selected);
+		for (std::uint32_t id : selected)
+		{
+			run(Core::get_proc(id));
+		}
+	}
+	else
+	{
+		for (Core::Proc& proc : Core::get_all_procs())
+		{
+			run(proc);
+		}
+	}
+	result = stats.to_json().dump();
+	return result.c_str();
+}
+
+// Arguments: proc path, "original" or "optimized". Used by optimizer_verify() in DM.
+extern "C" EXPORT const char* optimizer_use(int n_args, const char** args)
+{
+	if (!Core::initialize() || n_args < 2)
+	{
+		return Core::FAIL;
+	}
+	Core::Proc* proc = Core::try_get_proc(args[0]);
+	if (!proc)
+	{
+		return Core::FAIL;
+	}
+	bool ok = !strcmp(args[1], "original") ? Optimizer::use_original(*proc) : Optimizer::use_optimized(*proc);
+	return ok ? Core::SUCCESS : Core::FAIL;
+}
+
+// Puts back the original bytecode of one proc, or of every optimized proc if no argument is given.
+extern "C" EXPORT const char* optimizer_revert(int n_args, const char** args)
+{
+	if (!Core::initialize())
+	{
+		return Core::FAIL;
+	}
+	if (n_args < 1 || !args[0][0])
+	{
+		Optimizer::revert_all();
+		return Core::SUCCESS;
+	}
+	Core::Proc* proc = Core::try_get_proc(args[0]);
+	if (!proc)
+	{
+		return Core::FAIL;
+	}
+	Optimizer::revert(*proc);
+	return Core::SUCCESS;
+}
+
+// Returns hits, misses and fallbacks for every inline cache site as JSON.
+extern "C" EXPORT const char* inline_cache_stats(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return "";
+	}
+	result = Optimizer::inline_cache_stats().dump();
+	return result.c_str();
+}
+
+extern "C" EXPORT const char* inline_cache_reset(int n_args, const char** args)
+{
+	Optimizer::reset_inline_cache_stats();
+	return Core::SUCCESS;
+}
+
+// Binds DM procs to the built-in intrinsics and patches every call to them, see intrinsics.h.
+// Argument: a JSON object mapping proc paths to intrinsic names, e.g. {"/proc/cheap_hypotenuse": "hypotenuse"}.
+// Intrinsics registered from native code are installed too. Returns the number of patched procs and call sites as JSON.
+extern "C" EXPORT const char* intrinsics_initialize(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return "";
+	}
+	nlohmann::json bindings = n_args > 0 ? nlohmann::json::parse(args[0], nullptr, false) : nlohmann::json::object();
+	std::vector<std::string> unbound;
+	if (bindings.is_object())
+	{
+		for (auto& [path, builtin] : bindings.items())
+		{
+			if (!builtin.is_string() || !Optimizer::bind_builtin_intrinsic(path, builtin.get<std::string>()))
+			{
+				unbound.push_back(path);
+			}
+		}
+	}
+	nlohmann::json stats = Optimizer::install_intrinsics();
+	stats["unbound"] = unbound;
+	result = stats.dump();
+	return result.c_str();
+}
+
+extern "C" EXPORT const char* intrinsics_uninstall(int n_args, const char** args)
+{
+	Optimizer::uninstall_intrinsics();
+	return Core::SUCCESS;
+}
+
+// Returns native calls and fallbacks for every intrinsic as JSON.
+extern "C" EXPORT const char* intrinsic_stats(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return "";
+	}
+	result = Optimizer::intrinsic_stats().dump();
+	return result.c_str();
+}
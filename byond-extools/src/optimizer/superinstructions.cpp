@@ -0,0 +1,119 @@
+#include "superinstructions.h"
+#include "../dmdism/opcodes_enum.h"
+
+#include <array>
+#include <map>
+#include <tuple>
+#include <utility>
+
+// Handlers are specialised on the operation and, for the first few locals, on the slots too, so the common case
+// compiles down to a couple of loads, a type check and one float op. Higher slots read their operands from the
+// bytecode instead.
+constexpr std::uint32_t SPECIALISED_SLOTS = 8;
+
+template<Bytecode OP>
+static inline bool local_arithmetic(Value& a, Value& b, Value& dest)
+{
+	if (a.type != DataType::NUMBER || b.type != DataType::NUMBER || (dest.type != DataType::NUMBER && dest.type != DataType::NULL_D))
+	{
+		return false;
+	}
+	float result;
+	if constexpr (OP == Bytecode::ADD)
+	{
+		result = a.valuef + b.valuef;
+	}
+	else if constexpr (OP == Bytecode::SUB)
+	{
+		result = a.valuef - b.valuef;
+	}
+	else if constexpr (OP == Bytecode::MUL)
+	{
+		result = a.valuef * b.valuef;
+	}
+	else
+	{
+		static_assert(OP == Bytecode::DIV);
+		if (b.valuef == 0.0f)
+		{
+			return false; // let BYOND raise the division by zero error
+		}
+		result = a.valuef / b.valuef;
+	}
+	dest.type = DataType::NUMBER;
+	dest.valuef = result;
+	return true;
+}
+
+template<Bytecode OP, std::uint32_t M, std::uint32_t N, std::uint32_t X>
+static void local_arithmetic_handler(ExecutionContext* ctx)
+{
+	Value* locals = ctx->local_variables;
+	if (local_arithmetic<OP>(locals[M], locals[N], locals[X]))
+	{
+		ctx->current_opcode += Optimizer::LOCAL_ARITHMETIC_LENGTH;
+	}
+}
+
+template<Bytecode OP>
+static void local_arithmetic_handler_generic(ExecutionContext* ctx)
+{
+	// Operand positions relative to the handler: GETVAR LOCAL m at +1, GETVAR LOCAL n at +4, SETVAR LOCAL x at +8.
+	std::uint32_t* operands = ctx->bytecode + ctx->current_opcode;
+	Value* locals = ctx->local_variables;
+	if (local_arithmetic<OP>(locals[operands[3]], locals[operands[6]], locals[operands[10]]))
+	{
+		ctx->current_opcode += Optimizer::LOCAL_ARITHMETIC_LENGTH;
+	}
+}
+
+typedef std::array<opcode_handler, SPECIALISED_SLOTS * SPECIALISED_SLOTS * SPECIALISED_SLOTS> HandlerTable;
+
+template<Bytecode OP, std::size_t... I>
+static constexpr HandlerTable make_handler_table(std::index_sequence<I...>)
+{
+	return { &local_arithmetic_handler<OP, I / (SPECIALISED_SLOTS * SPECIALISED_SLOTS), I / SPECIALISED_SLOTS % SPECIALISED_SLOTS, I % SPECIALISED_SLOTS>... };
+}
+
+template<Bytecode OP>
+static constexpr HandlerTable handler_table = make_handler_table<OP>(std::make_index_sequence<SPECIALISED_SLOTS * SPECIALISED_SLOTS * SPECIALISED_SLOTS>());
+
+static opcode_handler find_handler(Bytecode op, std::uint32_t m, std::uint32_t n, std::uint32_t x)
+{
+	bool specialised = m < SPECIALISED_SLOTS && n < SPECIALISED_SLOTS && x < SPECIALISED_SLOTS;
+	std::size_t index = (m * SPECIALISED_SLOTS + n) * SPECIALISED_SLOTS + x;
+	switch (op)
+	{
+	case Bytecode::ADD:
+		return specialised ? handler_table<Bytecode::ADD>[index] : &local_arithmetic_handler_generic<Bytecode::ADD>;
+	case Bytecode::SUB:
+		return specialised ? handler_table<Bytecode::SUB>[index] : &local_arithmetic_handler_generic<Bytecode::SUB>;
+	case Bytecode::MUL:
+		return specialised ? handler_table<Bytecode::MUL>[index] : &local_arithmetic_handler_generic<Bytecode::MUL>;
+	case Bytecode::DIV:
+		return specialised ? handler_table<Bytecode::DIV>[index] : &local_arithmetic_handler_generic<Bytecode::DIV>;
+	default:
+		return nullptr;
+	}
+}
+
+std::uint32_t Optimizer::local_arithmetic_opcode(Bytecode op, std::uint32_t m, std::uint32_t n, std::uint32_t x)
+{
+	opcode_handler handler = find_handler(op, m, n, x);
+	if (!handler)
+	{
+		return 0;
+	}
+	bool specialised = m < SPECIALISED_SLOTS && n < SPECIALISED_SLOTS && x < SPECIALISED_SLOTS;
+	std::string name = std::string("SUPER_") + get_mnemonic(op);
+	if (specialised)
+	{
+		name += "_L" + std::to_string(m) + "_L" + std::to_string(n) + "_L" + std::to_string(x);
+	}
+	// Opcodes are registered once and shared by every proc. Core::cleanup() drops all handlers, so check it is still there.
+	if (auto ptr = Core::name_to_opcode.find(name); ptr != Core::name_to_opcode.end() && Core::opcode_handlers.count(ptr->second))
+	{
+		return ptr->second;
+	}
+	return Core::register_opcode(name, handler);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "../core/core.h"
+#include "../dmdism/opcodes.h"
+
+namespace Optimizer
+{
+	// Words covered by one local arithmetic superinstruction: GETVAR LOCAL m, GETVAR LOCAL n, <op>, SETVAR LOCAL x.
+	constexpr std::uint16_t LOCAL_ARITHMETIC_LENGTH = 10;
+
+	// Returns a custom opcode computing "local x = local m <op> local n", registering it on first use.
+	// The handler must be placed right in front of the original sequence. When m, n are numbers and x holds a
+	// number or null it does the arithmetic and skips the sequence, otherwise it does nothing and the original
+	// instructions run as usual. Returns 0 if `op` is not supported.
+	std::uint32_t local_arithmetic_opcode(Bytecode op, std::uint32_t m, std::uint32_t n, std::uint32_t x);
+}
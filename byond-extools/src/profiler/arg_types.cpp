@@ -0,0 +1,157 @@
+#include "arg_types.h"
+#include "../dmdism/opcodes.h"
+#include "../dmdism/helpers.h"
+
+#include <algorithm>
+#include <memory>
+
+bool Profiler::arg_profiling_enabled = false;
+
+static std::vector<std::unique_ptr<Profiler::ArgTypeProfile>> profiles;
+
+void Profiler::ArgTypeProfile::set_sample_rate(std::uint32_t rate)
+{
+	sample_rate = rate ? rate : 1;
+	countdown = sample_rate;
+}
+
+void Profiler::ArgTypeProfile::reset()
+{
+	for (auto& position : counts)
+	{
+		position.fill(0);
+	}
+	calls = 0;
+	samples = 0;
+	max_arg_count = 0;
+	countdown = sample_rate;
+}
+
+double Profiler::ArgTypeProfile::position_monomorphism(unsigned int position) const
+{
+	std::uint64_t total = 0;
+	std::uint32_t most = 0;
+	for (std::uint32_t count : counts[position])
+	{
+		total += count;
+		most = std::max(most, count);
+	}
+	return total ? (double)most / total : 1.0;
+}
+
+double Profiler::ArgTypeProfile::monomorphism() const
+{
+	double result = 1.0;
+	for (unsigned int i = 0; i <= max_arg_count; i++)
+	{
+		result = std::min(result, position_monomorphism(i));
+	}
+	return result;
+}
+
+static std::string type_name(unsigned int type)
+{
+	if (const char* name = datatype_name(type))
+	{
+		return name;
+	}
+	return tohex(type);
+}
+
+nlohmann::json Profiler::ArgTypeProfile::position_to_json(unsigned int position) const
+{
+	nlohmann::json types = nlohmann::json::object();
+	for (unsigned int type = 0; type < TYPE_SLOTS; type++)
+	{
+		if (counts[position][type])
+		{
+			types[type_name(type)] = counts[position][type];
+		}
+	}
+	return { {"types", types}, {"monomorphism", position_monomorphism(position)} };
+}
+
+nlohmann::json Profiler::ArgTypeProfile::to_json() const
+{
+	std::vector<nlohmann::json> args;
+	for (unsigned int i = 1; i <= max_arg_count; i++)
+	{
+		args.push_back(position_to_json(i));
+	}
+	return {
+		{"proc", Core::get_proc(proc_id).name},
+		{"calls", calls},
+		{"samples", samples},
+		{"sample_rate", sample_rate},
+		{"monomorphism", monomorphism()},
+		{"src", position_to_json(0)},
+		{"args", args},
+	};
+}
+
+Profiler::ArgTypeProfile* Profiler::arg_profile(std::uint32_t proc_id)
+{
+	return proc_id < profiles.size() ? profiles[proc_id].get() : nullptr;
+}
+
+void Profiler::profile_arg_types(std::uint32_t proc_id, bool enable, std::uint32_t sample_rate)
+{
+	if (enable)
+	{
+		if (profiles.size() <= proc_id)
+		{
+			profiles.resize(Core::get_all_procs().size());
+		}
+		if (!profiles[proc_id])
+		{
+			profiles[proc_id] = std::make_unique<ArgTypeProfile>();
+			profiles[proc_id]->proc_id = proc_id;
+		}
+		profiles[proc_id]->set_sample_rate(sample_rate);
+	}
+	else if (proc_id < profiles.size())
+	{
+		profiles[proc_id].reset();
+	}
+	arg_profiling_enabled = std::any_of(profiles.begin(), profiles.end(), [](auto& profile) { return profile != nullptr; });
+}
+
+void Profiler::reset_arg_types()
+{
+	for (auto& profile : profiles)
+	{
+		if (profile)
+		{
+			profile->reset();
+		}
+	}
+}
+
+nlohmann::json Profiler::arg_types_json(bool by_monomorphism)
+{
+	std::vector<const ArgTypeProfile*> sorted;
+	for (auto& profile : profiles)
+	{
+		if (profile)
+		{
+			sorted.push_back(profile.get());
+		}
+	}
+	if (by_monomorphism)
+	{
+		std::sort(sorted.begin(), sorted.end(), [](const ArgTypeProfile* lhs, const ArgTypeProfile* rhs) {
+			double l = lhs->monomorphism(), r = rhs->monomorphism();
+			return l != r ? l > r : lhs->call_count() > rhs->call_count();
+		});
+	}
+	else
+	{
+		std::sort(sorted.begin(), sorted.end(), [](const ArgTypeProfile* lhs, const ArgTypeProfile* rhs) { return lhs->call_count() > rhs->call_count(); });
+	}
+	std::vector<nlohmann::json> result;
+	for (const ArgTypeProfile* profile : sorted)
+	{
+		result.push_back(profile->to_json());
+	}
+	return result;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../core/core.h"
+#include "../third_party/json.hpp"
+
+#include <array>
+
+namespace Profiler
+{
+	// Tallies the runtime type of src and of each argument for one proc, as input for deciding which procs
+	// are worth specialising. Only one in `sample_rate` calls is inspected, every call is counted.
+	class ArgTypeProfile
+	{
+	public:
+		static constexpr unsigned int MAX_ARGS = 8;
+		static constexpr unsigned int TYPE_SLOTS = 0x60;
+
+		void record(DataType src_type, const Value* args, unsigned int arg_count)
+		{
+			calls++;
+			if (--countdown)
+			{
+				return;
+			}
+			countdown = sample_rate;
+			samples++;
+			counts[0][type_slot(src_type)]++;
+			if (arg_count > MAX_ARGS)
+			{
+				arg_count = MAX_ARGS;
+			}
+			for (unsigned int i = 0; i < arg_count; i++)
+			{
+				counts[i + 1][type_slot(args[i].type)]++;
+			}
+			if (arg_count > max_arg_count)
+			{
+				max_arg_count = arg_count;
+			}
+		}
+
+		void set_sample_rate(std::uint32_t rate);
+		void reset();
+
+		// Share of samples that had the most common type, over the least predictable position.
+		// 1.0 means every sampled call saw the same types.
+		double monomorphism() const;
+		std::uint64_t call_count() const { return calls; }
+		nlohmann::json to_json() const;
+
+		std::uint32_t proc_id = 0;
+
+	private:
+		static unsigned int type_slot(DataType type) { return (unsigned int)type < TYPE_SLOTS ? (unsigned int)type : TYPE_SLOTS - 1; }
+		double position_monomorphism(unsigned int position) const;
+		nlohmann::json position_to_json(unsigned int position) const;
+
+		// Position 0 is src, the rest are arguments in order.
+		std::array<std::array<std::uint32_t, TYPE_SLOTS>, MAX_ARGS + 1> counts = {};
+		std::uint64_t calls = 0;
+		std::uint64_t samples = 0;
+		std::uint32_t sample_rate = 1;
+		std::uint32_t countdown = 1;
+		unsigned int max_arg_count = 0;
+	};
+
+	extern bool arg_profiling_enabled;
+
+	// Hot path lookup, returns nullptr if the proc is not being profiled.
+	ArgTypeProfile* arg_profile(std::uint32_t proc_id);
+
+	void profile_arg_types(std::uint32_t proc_id, bool enable, std::uint32_t sample_rate);
+	void reset_arg_types();
+	// Profiles sorted by call count, or by monomorphism with the most predictable procs first.
+	nlohmann::json arg_types_json(bool by_monomorphism);
+}
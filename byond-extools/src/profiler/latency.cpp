@@ -0,0 +1,226 @@
+#include "latency.h"
+
+#include <algorithm>
+#include <unordered_map>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+bool Profiler::latency_tracking_enabled = false;
+std::chrono::nanoseconds Profiler::latency_interval = std::chrono::nanoseconds::zero();
+
+static std::vector<std::unique_ptr<Profiler::LatencyTracker>> proc_trackers;
+static std::unordered_map<std::uint32_t, std::unique_ptr<Profiler::LatencyTracker>> opcode_trackers;
+
+static unsigned int floor_log2(std::uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	if (_BitScanReverse(&index, (unsigned long)(value >> 32)))
+	{
+		return index + 32;
+	}
+	_BitScanReverse(&index, (unsigned long)value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+unsigned int Profiler::LatencyHistogram::bucket_of(std::uint64_t value)
+{
+	if (value < SUB_BUCKETS)
+	{
+		return (unsigned int)value;
+	}
+	unsigned int exponent = floor_log2(value);
+	if (exponent > MAX_EXPONENT)
+	{
+		return BUCKET_COUNT - 1;
+	}
+	unsigned int sub_bucket = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+	return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+std::uint64_t Profiler::LatencyHistogram::bucket_upper_bound(unsigned int bucket)
+{
+	if (bucket < SUB_BUCKETS)
+	{
+		return bucket;
+	}
+	unsigned int exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+	unsigned int sub_bucket = bucket % SUB_BUCKETS;
+	unsigned int shift = exponent - SUB_BUCKET_BITS;
+	return ((std::uint64_t)(SUB_BUCKETS + sub_bucket + 1) << shift) - 1;
+}
+
+void Profiler::LatencyHistogram::record(std::uint64_t nanoseconds)
+{
+	buckets[bucket_of(nanoseconds)]++;
+	total_count++;
+	sum += nanoseconds;
+	if (nanoseconds > max_value)
+	{
+		max_value = nanoseconds;
+	}
+}
+
+void Profiler::LatencyHistogram::reset()
+{
+	buckets.fill(0);
+	total_count = 0;
+	sum = 0;
+	max_value = 0;
+}
+
+std::uint64_t Profiler::LatencyHistogram::percentile(double p) const
+{
+	if (total_count == 0)
+	{
+		return 0;
+	}
+	std::uint64_t wanted = (std::uint64_t)(total_count * (p / 100.0) + 0.5);
+	if (wanted == 0)
+	{
+		wanted = 1;
+	}
+	std::uint64_t seen = 0;
+	for (unsigned int i = 0; i < BUCKET_COUNT; i++)
+	{
+		seen += buckets[i];
+		if (seen >= wanted)
+		{
+			return std::min(bucket_upper_bound(i), max_value);
+		}
+	}
+	return max_value;
+}
+
+void Profiler::LatencyTracker::record(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	if (latency_interval.count() && end - interval_start >= latency_interval)
+	{
+		if (current.count())
+		{
+			previous = current;
+			has_previous = true;
+		}
+		current.reset();
+		interval_start = end;
+	}
+	current.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+const Profiler::LatencyHistogram& Profiler::LatencyTracker::report() const
+{
+	if (latency_interval.count() && has_previous)
+	{
+		return previous;
+	}
+	return current;
+}
+
+void Profiler::LatencyTracker::reset()
+{
+	current.reset();
+	previous.reset();
+	has_previous = false;
+	interval_start = std::chrono::steady_clock::now();
+}
+
+Profiler::LatencyTracker* Profiler::proc_latency(std::uint32_t proc_id)
+{
+	return proc_id < proc_trackers.size() ? proc_trackers[proc_id].get() : nullptr;
+}
+
+Profiler::LatencyTracker* Profiler::opcode_latency(std::uint32_t opcode)
+{
+	if (opcode_trackers.empty())
+	{
+		return nullptr;
+	}
+	auto ptr = opcode_trackers.find(opcode);
+	return ptr != opcode_trackers.end() ? ptr->second.get() : nullptr;
+}
+
+static void update_enabled()
+{
+	bool any_proc = false;
+	for (auto& tracker : proc_trackers)
+	{
+		if (tracker)
+		{
+			any_proc = true;
+			break;
+		}
+	}
+	Profiler::latency_tracking_enabled = any_proc || !opcode_trackers.empty();
+}
+
+void Profiler::track_proc_latency(std::uint32_t proc_id, bool enable)
+{
+	if (enable)
+	{
+		if (proc_trackers.size() <= proc_id)
+		{
+			proc_trackers.resize(Core::get_all_procs().size());
+		}
+		if (!proc_trackers[proc_id])
+		{
+			proc_trackers[proc_id] = std::make_unique<LatencyTracker>();
+			proc_trackers[proc_id]->reset();
+		}
+	}
+	else if (proc_id < proc_trackers.size())
+	{
+		proc_trackers[proc_id].reset();
+	}
+	update_enabled();
+}
+
+void Profiler::track_opcode_latency(std::uint32_t opcode, bool enable)
+{
+	if (enable)
+	{
+		auto& tracker = opcode_trackers[opcode];
+		if (!tracker)
+		{
+			tracker = std::make_unique<LatencyTracker>();
+			tracker->reset();
+		}
+	}
+	else
+	{
+		opcode_trackers.erase(opcode);
+	}
+	update_enabled();
+}
+
+void Profiler::reset_latency()
+{
+	for (auto& tracker : proc_trackers)
+	{
+		if (tracker)
+		{
+			tracker->reset();
+		}
+	}
+	for (auto& [opcode, tracker] : opcode_trackers)
+	{
+		tracker->reset();
+	}
+}
+
+nlohmann::json Profiler::latency_to_json(const LatencyTracker& tracker)
+{
+	const LatencyHistogram& h = tracker.report();
+	// Microseconds, to match the rest of the profiler output.
+	return {
+		{"count", h.count()},
+		{"mean", h.mean() / 1000.0},
+		{"p50", h.percentile(50.0) / 1000.0},
+		{"p99", h.percentile(99.0) / 1000.0},
+		{"p999", h.percentile(99.9) / 1000.0},
+		{"max", h.max() / 1000.0},
+	};
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../core/core.h"
+#include "../third_party/json.hpp"
+
+#include <array>
+#include <chrono>
+#include <memory>
+
+namespace Profiler
+{
+	// Log-bucketed latency histogram in the style of HdrHistogram. Every power of two is split into
+	// SUB_BUCKETS linear buckets, giving roughly 6% relative precision from 1ns up to about 36 minutes
+	// (2^41ns) in a fixed 2.4KB footprint. Recording never allocates.
+	class LatencyHistogram
+	{
+	public:
+		static constexpr unsigned int SUB_BUCKET_BITS = 4;
+		static constexpr unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+		static constexpr unsigned int MAX_EXPONENT = 40;
+		static constexpr unsigned int BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+		void record(std::uint64_t nanoseconds);
+		void reset();
+
+		std::uint64_t count() const { return total_count; }
+		std::uint64_t max() const { return max_value; }
+		std::uint64_t mean() const { return total_count ? sum / total_count : 0; }
+		// Returns an upper bound for the given percentile (0-100) in nanoseconds.
+		std::uint64_t percentile(double p) const;
+
+	private:
+		static unsigned int bucket_of(std::uint64_t value);
+		static std::uint64_t bucket_upper_bound(unsigned int bucket);
+
+		std::array<std::uint32_t, BUCKET_COUNT> buckets = {};
+		std::uint64_t total_count = 0;
+		std::uint64_t sum = 0;
+		std::uint64_t max_value = 0;
+	};
+
+	// Histogram for one proc or opcode. In interval mode the current histogram is retired once the
+	// interval elapses, and queries report the last complete interval instead of an ever-growing total.
+	class LatencyTracker
+	{
+	public:
+		void record(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+		const LatencyHistogram& report() const;
+		void reset();
+
+	private:
+		LatencyHistogram current;
+		LatencyHistogram previous;
+		std::chrono::steady_clock::time_point interval_start;
+		bool has_previous = false;
+	};
+
+	extern bool latency_tracking_enabled;
+	extern std::chrono::nanoseconds latency_interval; // zero means cumulative
+
+	// Hot path lookups, return nullptr if the proc or opcode is not tracked. The pointer is only valid
+	// until tracking is next changed, which any proc call can do, so don't keep it across one.
+	LatencyTracker* proc_latency(std::uint32_t proc_id);
+	LatencyTracker* opcode_latency(std::uint32_t opcode);
+
+	void track_proc_latency(std::uint32_t proc_id, bool enable);
+	void track_opcode_latency(std::uint32_t opcode, bool enable);
+	void reset_latency();
+	nlohmann::json latency_to_json(const LatencyTracker& tracker);
+}
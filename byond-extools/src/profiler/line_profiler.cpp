@@ -0,0 +1,243 @@
+#include "line_profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+std::atomic<bool> Profiler::line_sample_pending = false;
+
+static std::unordered_map<std::uint64_t, Profiler::LineCounts> line_counts;
+static std::uint64_t total_samples = 0;
+static std::uint64_t stale_samples = 0;
+
+static std::thread sampler_thread;
+static std::atomic<bool> sampler_running = false;
+static std::atomic<long long> sample_requested_at = 0;
+static std::chrono::microseconds sample_interval;
+
+static std::uint64_t line_key(std::uint32_t file, std::uint32_t line)
+{
+	return ((std::uint64_t)file << 32) | line;
+}
+
+static long long now_ticks()
+{
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+bool Profiler::start_line_profiler(std::chrono::microseconds interval)
+{
+	if (sampler_running || interval.count() <= 0)
+	{
+		return false;
+	}
+	sample_interval = interval;
+	sampler_running = true;
+	sampler_thread = std::thread([interval]() {
+		while (sampler_running)
+		{
+			std::this_thread::sleep_for(interval);
+			sample_requested_at = now_ticks();
+			line_sample_pending = true;
+		}
+	});
+	return true;
+}
+
+void Profiler::stop_line_profiler()
+{
+	if (!sampler_running)
+	{
+		return;
+	}
+	sampler_running = false;
+	sampler_thread.join();
+	line_sample_pending = false;
+}
+
+bool Profiler::line_profiler_running()
+{
+	return sampler_running;
+}
+
+void Profiler::reset_line_profiler()
+{
+	line_counts.clear();
+	total_samples = 0;
+	stale_samples = 0;
+}
+
+void Profiler::take_line_sample(ExecutionContext* ctx)
+{
+	if (!line_sample_pending.exchange(false))
+	{
+		return;
+	}
+	// The server idles between ticks, and a request made while idle would be picked up by whatever line
+	// happens to run first. Those samples don't say anything about where time goes, so throw them away.
+	auto waited = std::chrono::steady_clock::duration(now_ticks() - sample_requested_at);
+	if (waited > sample_interval * 2)
+	{
+		stale_samples++;
+		return;
+	}
+	total_samples++;
+
+	static std::vector<std::uint64_t> seen;
+	seen.clear();
+	bool innermost = true;
+	for (; ctx; ctx = ctx->parent_context)
+	{
+		if (!ctx->dbg_proc_file || !ctx->dbg_current_line)
+		{
+			innermost = false;
+			continue;
+		}
+		std::uint64_t key = line_key(ctx->dbg_proc_file, ctx->dbg_current_line);
+		LineCounts& counts = line_counts[key];
+		counts.proc_id = ctx->constants->proc_id;
+		if (innermost)
+		{
+			counts.exclusive++;
+			innermost = false;
+		}
+		// Recursion puts the same line on the stack more than once, but it only spent the time once.
+		if (std::find(seen.begin(), seen.end(), key) == seen.end())
+		{
+			counts.inclusive++;
+			seen.push_back(key);
+		}
+	}
+}
+
+struct LineEntry
+{
+	std::uint32_t file;
+	std::uint32_t line;
+	Profiler::LineCounts counts;
+};
+
+static std::vector<LineEntry> sorted_lines(bool by_inclusive, std::size_t count)
+{
+	std::vector<LineEntry> lines;
+	lines.reserve(line_counts.size());
+	for (auto& [key, counts] : line_counts)
+	{
+		lines.push_back({ (std::uint32_t)(key >> 32), (std::uint32_t)key, counts });
+	}
+	auto by_hits = [by_inclusive](const LineEntry& lhs, const LineEntry& rhs) {
+		return by_inclusive ? lhs.counts.inclusive > rhs.counts.inclusive : lhs.counts.exclusive > rhs.counts.exclusive;
+	};
+	count = std::min(count, lines.size());
+	std::partial_sort(lines.begin(), lines.begin() + count, lines.end(), by_hits);
+	lines.resize(count);
+	return lines;
+}
+
+static std::vector<std::string> split_lines(std::istream& in)
+{
+	std::vector<std::string> result;
+	std::string line;
+	while (std::getline(in, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		result.push_back(line);
+	}
+	return result;
+}
+
+// Resolves file ids to names and source text. stddef.dm is built into BYOND, everything else is read
+// from disk relative to the .dmb, which is where DreamMaker leaves it.
+class SourceCache
+{
+	std::unordered_map<std::uint32_t, std::pair<std::string, std::vector<std::string>>> files;
+
+public:
+	const std::string& name(std::uint32_t file_id)
+	{
+		return load(file_id).first;
+	}
+
+	std::string line(std::uint32_t file_id, std::uint32_t line)
+	{
+		const std::vector<std::string>& source = load(file_id).second;
+		if (line == 0 || line > source.size())
+		{
+			return "";
+		}
+		const std::string& text = source[line - 1];
+		std::size_t start = text.find_first_not_of(" \t");
+		return start == std::string::npos ? "" : text.substr(start);
+	}
+
+private:
+	std::pair<std::string, std::vector<std::string>>& load(std::uint32_t file_id)
+	{
+		auto ptr = files.find(file_id);
+		if (ptr != files.end())
+		{
+			return ptr->second;
+		}
+		auto& entry = files[file_id];
+		entry.first = Core::GetStringFromId(file_id);
+		if (entry.first == "stddef.dm")
+		{
+			if (StdDefDM)
+			{
+				std::istringstream in(StdDefDM(nullptr));
+				entry.second = split_lines(in);
+			}
+		}
+		else
+		{
+			std::ifstream in(entry.first);
+			if (in)
+			{
+				entry.second = split_lines(in);
+			}
+		}
+		return entry;
+	}
+};
+
+nlohmann::json Profiler::line_report_json(bool by_inclusive, std::size_t count)
+{
+	SourceCache sources;
+	std::vector<nlohmann::json> lines;
+	for (const LineEntry& entry : sorted_lines(by_inclusive, count))
+	{
+		lines.push_back({
+			{"file", sources.name(entry.file)},
+			{"line", entry.line},
+			{"proc", Core::get_proc(entry.counts.proc_id).name},
+			{"exclusive", entry.counts.exclusive},
+			{"inclusive", entry.counts.inclusive},
+			{"source", sources.line(entry.file, entry.line)},
+		});
+	}
+	return { {"samples", total_samples}, {"stale", stale_samples}, {"lines", lines} };
+}
+
+std::string Profiler::line_report_text(bool by_inclusive, std::size_t count)
+{
+	SourceCache sources;
+	std::ostringstream out;
+	double total = total_samples ? (double)total_samples : 1.0;
+	out << total_samples << " samples (" << stale_samples << " stale), sorted by " << (by_inclusive ? "inclusive" : "exclusive") << " hits\n";
+	out << "   excl%    incl%  location\n";
+	out << std::fixed << std::setprecision(2);
+	for (const LineEntry& entry : sorted_lines(by_inclusive, count))
+	{
+		out << std::setw(7) << entry.counts.exclusive * 100.0 / total << "% "
+			<< std::setw(7) << entry.counts.inclusive * 100.0 / total << "%  "
+			<< sources.name(entry.file) << ":" << entry.line << " (" << Core::get_proc(entry.counts.proc_id).name << ")\n"
+			<< "                    " << sources.line(entry.file, entry.line) << "\n";
+	}
+	return out.str();
+}
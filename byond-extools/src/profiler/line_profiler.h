@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../core/core.h"
+#include "../third_party/json.hpp"
+
+#include <atomic>
+#include <chrono>
+
+namespace Profiler
+{
+	// Sampling profiler that attributes time to source lines rather than procs. A background thread raises
+	// line_sample_pending at a fixed rate and the game thread picks it up from the singlestep hook, where it is
+	// safe to walk the context chain. The innermost frame's line gets an exclusive hit and every distinct line
+	// on the call stack gets an inclusive hit.
+	struct LineCounts
+	{
+		std::uint32_t proc_id = 0;
+		std::uint32_t exclusive = 0;
+		std::uint32_t inclusive = 0;
+	};
+
+	extern std::atomic<bool> line_sample_pending;
+
+	bool start_line_profiler(std::chrono::microseconds interval);
+	void stop_line_profiler();
+	void reset_line_profiler();
+	bool line_profiler_running();
+
+	// Called from the singlestep hook once line_sample_pending is set.
+	void take_line_sample(ExecutionContext* ctx);
+
+	// Lines sorted by exclusive (or inclusive) hits, annotated with file names and source text.
+	nlohmann::json line_report_json(bool by_inclusive, std::size_t count);
+	std::string line_report_text(bool by_inclusive, std::size_t count);
+}
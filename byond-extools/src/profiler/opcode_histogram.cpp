@@ -0,0 +1,124 @@
+#include "opcode_histogram.h"
+#include "../dmdism/opcodes.h"
+
+#include <algorithm>
+#include <memory>
+
+bool Profiler::opcode_counting_enabled = false;
+
+static Profiler::OpcodeCounts global_counts;
+static std::vector<std::unique_ptr<Profiler::OpcodeCounts>> proc_counts;
+
+Profiler::OpcodeCounts::OpcodeCounts() : native(native_opcode_count, 0)
+{
+}
+
+void Profiler::count_opcode(ExecutionContext* ctx)
+{
+	std::uint32_t opcode = ctx->bytecode[ctx->current_opcode];
+	global_counts.add(opcode);
+
+	std::uint32_t proc_id = ctx->constants->proc_id;
+	if (proc_id >= proc_counts.size())
+	{
+		proc_counts.resize(std::max<std::size_t>(proc_id + 1, Core::get_all_procs().size()));
+	}
+	std::unique_ptr<OpcodeCounts>& counts = proc_counts[proc_id];
+	if (!counts)
+	{
+		counts = std::make_unique<OpcodeCounts>();
+	}
+	counts->add(opcode);
+}
+
+void Profiler::reset_opcode_counts()
+{
+	global_counts = OpcodeCounts();
+	proc_counts.clear();
+}
+
+static std::string opcode_name(std::uint32_t opcode, const std::unordered_map<std::uint32_t, std::string>& custom_names)
+{
+	if (opcode < native_opcode_count)
+	{
+		return get_mnemonic((Bytecode)opcode);
+	}
+	auto ptr = custom_names.find(opcode);
+	return ptr != custom_names.end() ? ptr->second : "???";
+}
+
+static std::uint64_t total_of(const Profiler::OpcodeCounts& counts)
+{
+	std::uint64_t total = 0;
+	for (std::uint64_t count : counts.native)
+	{
+		total += count;
+	}
+	for (auto& [opcode, count] : counts.other)
+	{
+		total += count;
+	}
+	return total;
+}
+
+static nlohmann::json counts_to_json(const Profiler::OpcodeCounts& counts)
+{
+	std::unordered_map<std::uint32_t, std::string> custom_names;
+	for (auto& [name, id] : Core::name_to_opcode)
+	{
+		custom_names[id] = name;
+	}
+
+	std::vector<std::pair<std::uint32_t, std::uint64_t>> nonzero;
+	for (std::uint32_t opcode = 0; opcode < counts.native.size(); opcode++)
+	{
+		if (counts.native[opcode])
+		{
+			nonzero.emplace_back(opcode, counts.native[opcode]);
+		}
+	}
+	for (auto& [opcode, count] : counts.other)
+	{
+		nonzero.emplace_back(opcode, count);
+	}
+	std::sort(nonzero.begin(), nonzero.end(), [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+
+	std::vector<nlohmann::json> opcodes;
+	opcodes.reserve(nonzero.size());
+	for (auto& [opcode, count] : nonzero)
+	{
+		opcodes.push_back({ {"opcode", opcode_name(opcode, custom_names)}, {"count", count} });
+	}
+	return { {"total", total_of(counts)}, {"opcodes", opcodes} };
+}
+
+nlohmann::json Profiler::opcode_counts_json(std::size_t proc_count)
+{
+	std::vector<std::pair<std::uint64_t, std::uint32_t>> procs;
+	for (std::uint32_t i = 0; i < proc_counts.size(); i++)
+	{
+		if (proc_counts[i])
+		{
+			procs.emplace_back(total_of(*proc_counts[i]), i);
+		}
+	}
+	proc_count = std::min(proc_count, procs.size());
+	std::partial_sort(procs.begin(), procs.begin() + proc_count, procs.end(), std::greater<>());
+
+	nlohmann::json result = counts_to_json(global_counts);
+	std::vector<nlohmann::json> per_proc;
+	for (std::size_t i = 0; i < proc_count; i++)
+	{
+		per_proc.push_back(proc_opcode_counts_json(procs[i].second));
+	}
+	result["procs"] = per_proc;
+	return result;
+}
+
+nlohmann::json Profiler::proc_opcode_counts_json(std::uint32_t proc_id)
+{
+	static const OpcodeCounts empty;
+	nlohmann::json result = counts_to_json(proc_id < proc_counts.size() && proc_counts[proc_id] ? *proc_counts[proc_id] : empty);
+	result["proc"] = Core::get_proc(proc_id).name;
+	return result;
+}
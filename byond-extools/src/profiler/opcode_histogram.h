@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../core/core.h"
+#include "../third_party/json.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace Profiler
+{
+	// Counts executed instructions from the singlestep hook. Native opcodes index straight into a flat array as
+	// long as opcodes_table.inl. Custom opcodes registered through Core::register_opcode, of which the optimizer
+	// can make hundreds, and anything else are counted by opcode.
+	struct OpcodeCounts
+	{
+		std::vector<std::uint64_t> native;
+		std::unordered_map<std::uint32_t, std::uint64_t> other;
+
+		OpcodeCounts();
+		void add(std::uint32_t opcode)
+		{
+			if (opcode < native.size())
+			{
+				native[opcode]++;
+			}
+			else
+			{
+				other[opcode]++;
+			}
+		}
+	};
+
+	extern bool opcode_counting_enabled;
+
+	// Called from the singlestep hook for every instruction while counting is enabled.
+	void count_opcode(ExecutionContext* ctx);
+
+	void reset_opcode_counts();
+	// Global counts plus the `proc_count` procs that executed the most instructions, each with their own
+	// counts. Opcodes are sorted by count and named with get_mnemonic.
+	nlohmann::json opcode_counts_json(std::size_t proc_count);
+	nlohmann::json proc_opcode_counts_json(std::uint32_t proc_id);
+}
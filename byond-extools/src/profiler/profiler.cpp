@@ -0,0 +1,166 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+Profiler::DeltaTracker Profiler::dm_tracker;
+
+static unsigned long long since(ProfileEntry before, ProfileEntry after)
+{
+	unsigned long long a = before.as_microseconds();
+	unsigned long long b = after.as_microseconds();
+	return b >= a ? b - a : b; // BYOND's profiler was cleared in the meantime
+}
+
+unsigned long long Profiler::Delta::get(SortKey key) const
+{
+	switch (key)
+	{
+	case SortKey::SELF:
+		return self;
+	case SortKey::TOTAL:
+		return total;
+	case SortKey::REAL:
+		return real;
+	case SortKey::OVERTIME:
+		return overtime;
+	case SortKey::CALLS:
+		return call_count;
+	}
+	return 0;
+}
+
+bool Profiler::locate_table(Table& out)
+{
+	out = Table();
+	const std::size_t count = Core::get_all_procs().size();
+	if (count == 0)
+	{
+		return false;
+	}
+	// GetProfileInfo indexes into one contiguous array. Checking both ends makes sure we can copy it in one go
+	// instead of making a call per proc.
+	ProfileInfo* first = GetProfileInfo(0);
+	ProfileInfo* last = GetProfileInfo(count - 1);
+	if (!first || last != first + (count - 1))
+	{
+		return false;
+	}
+	out.entries = first;
+	out.count = count;
+	return true;
+}
+
+bool Profiler::take_snapshot(const Table& table, Snapshot& out)
+{
+	if (!table.entries)
+	{
+		return false;
+	}
+	out.taken_at = std::chrono::steady_clock::now();
+	out.entries.resize(table.count);
+	std::memcpy(out.entries.data(), table.entries, table.count * sizeof(ProfileInfo));
+	return true;
+}
+
+std::vector<Profiler::Delta> Profiler::diff(const Snapshot& before, const Snapshot& after)
+{
+	std::vector<Delta> result;
+	static const ProfileInfo empty = {};
+	for (std::uint32_t i = 0; i < after.entries.size(); i++)
+	{
+		const ProfileInfo& b = i < before.entries.size() ? before.entries[i] : empty;
+		const ProfileInfo& a = after.entries[i];
+		if (a.call_count == b.call_count && a.real.as_microseconds() == b.real.as_microseconds())
+		{
+			continue;
+		}
+		result.push_back({
+			i,
+			a.call_count >= b.call_count ? a.call_count - b.call_count : a.call_count,
+			since(b.self, a.self),
+			since(b.total, a.total),
+			since(b.real, a.real),
+			since(b.overtime, a.overtime),
+		});
+	}
+	return result;
+}
+
+void Profiler::top(std::vector<Delta>& deltas, SortKey key, std::size_t count)
+{
+	auto by_key = [key](const Delta& lhs, const Delta& rhs) { return lhs.get(key) > rhs.get(key); };
+	if (count < deltas.size())
+	{
+		std::partial_sort(deltas.begin(), deltas.begin() + count, deltas.end(), by_key);
+		deltas.resize(count);
+	}
+	else
+	{
+		std::sort(deltas.begin(), deltas.end(), by_key);
+	}
+}
+
+std::vector<Profiler::Delta> Profiler::DeltaTracker::advance(const Table& table, SortKey key, std::size_t count)
+{
+	Snapshot current;
+	if (!take_snapshot(table, current))
+	{
+		// Keep the previous snapshot, so the next delta that works still covers this interval.
+		return {};
+	}
+	interval_seconds = previous.entries.empty() ? 0.0 : std::chrono::duration<double>(current.taken_at - previous.taken_at).count();
+	std::vector<Delta> deltas = diff(previous, current);
+	previous = std::move(current);
+	top(deltas, key, count);
+	return deltas;
+}
+
+void Profiler::DeltaTracker::reset()
+{
+	previous = {};
+	interval_seconds = 0.0;
+}
+
+Profiler::SortKey Profiler::sort_key_from_string(const std::string& name)
+{
+	if (name == "total")
+		return SortKey::TOTAL;
+	if (name == "real")
+		return SortKey::REAL;
+	if (name == "overtime")
+		return SortKey::OVERTIME;
+	if (name == "calls")
+		return SortKey::CALLS;
+	return SortKey::SELF;
+}
+
+nlohmann::json Profiler::time_to_json(unsigned long long microseconds)
+{
+	return { {"seconds", microseconds / 1000000}, {"microseconds", microseconds % 1000000} };
+}
+
+nlohmann::json Profiler::delta_to_json(const Delta& delta)
+{
+	Core::Proc& p = Core::get_proc(delta.proc_id);
+	return {
+		{"proc", p.name},
+		{"override_id", p.override_id},
+		{"call_count", delta.call_count},
+		{"self", time_to_json(delta.self)},
+		{"total", time_to_json(delta.total)},
+		{"real", time_to_json(delta.real)},
+		{"overtime", time_to_json(delta.overtime)},
+	};
+}
+
+nlohmann::json Profiler::deltas_to_json(const std::vector<Delta>& deltas, double interval_seconds)
+{
+	std::vector<nlohmann::json> procs;
+	procs.reserve(deltas.size());
+	for (const Delta& d : deltas)
+	{
+		procs.push_back(delta_to_json(d));
+	}
+	return { {"interval", interval_seconds}, {"procs", procs} };
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "../core/core.h"
+#include "../third_party/json.hpp"
+
+#include <chrono>
+#include <vector>
+
+namespace Profiler
+{
+	enum class SortKey
+	{
+		SELF,
+		TOTAL,
+		REAL,
+		OVERTIME,
+		CALLS,
+	};
+
+	// BYOND's ProfileInfo table, one entry per proc. GetProfileInfo allocates it the first time it's asked and it
+	// stays put after that, so once it's been located on the main thread any thread can copy it.
+	struct Table
+	{
+		ProfileInfo* entries = nullptr;
+		std::size_t count = 0;
+	};
+
+	// A copy of BYOND's ProfileInfo table, indexed by proc id.
+	struct Snapshot
+	{
+		std::chrono::steady_clock::time_point taken_at;
+		std::vector<ProfileInfo> entries;
+	};
+
+	// The difference between two snapshots for a single proc, in microseconds.
+	struct Delta
+	{
+		std::uint32_t proc_id;
+		std::uint32_t call_count;
+		unsigned long long self;
+		unsigned long long total;
+		unsigned long long real;
+		unsigned long long overtime;
+
+		unsigned long long get(SortKey key) const;
+	};
+
+	// Remembers the previous snapshot so every consumer (DM, the debugger...) gets its own deltas.
+	class DeltaTracker
+	{
+	public:
+		// Takes a new snapshot and returns the top `count` procs that changed since the last call, sorted by `key`.
+		// The first call diffs against an empty snapshot, so it returns totals since profiling began. Returns
+		// nothing if the table wasn't located.
+		std::vector<Delta> advance(const Table& table, SortKey key, std::size_t count);
+		double seconds_since_last() const { return interval_seconds; }
+		void reset();
+
+	private:
+		Snapshot previous;
+		double interval_seconds = 0.0;
+	};
+
+	// Main thread only, see Table.
+	bool locate_table(Table& out);
+	bool take_snapshot(const Table& table, Snapshot& out);
+	std::vector<Delta> diff(const Snapshot& before, const Snapshot& after);
+	void top(std::vector<Delta>& deltas, SortKey key, std::size_t count);
+
+	SortKey sort_key_from_string(const std::string& name);
+	nlohmann::json time_to_json(unsigned long long microseconds);
+	nlohmann::json delta_to_json(const Delta& delta);
+	nlohmann::json deltas_to_json(const std::vector<Delta>& deltas, double interval_seconds);
+
+	extern DeltaTracker dm_tracker;
+}
@@ -0,0 +1,239 @@
+#include "../core/core.h"
+#include "profiler.h"
+#include "latency.h"
+#include "line_profiler.h"
+#include "opcode_histogram.h"
+#include "arg_types.h"
+#include "../debug_server/debug_server.h"
+
+// Returns a JSON object describing which procs got slower since the previous call.
+// Arguments: sort key ("self", "total", "real", "overtime" or "calls"), number of procs to return.
+extern "C" EXPORT const char* profile_delta(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return Core::FAIL;
+	}
+	Profiler::SortKey key = Profiler::sort_key_from_string(n_args > 0 ? args[0] : "self");
+	std::size_t count = n_args > 1 ? std::strtoul(args[1], nullptr, 10) : 20;
+	Profiler::Table table;
+	Profiler::locate_table(table);
+	std::vector<Profiler::Delta> deltas = Profiler::dm_tracker.advance(table, key, count);
+	result = Profiler::deltas_to_json(deltas, Profiler::dm_tracker.seconds_since_last()).dump();
+	return result.c_str();
+}
+
+extern "C" EXPORT const char* profile_delta_reset(int n_args, const char** args)
+{
+	Profiler::dm_tracker.reset();
+	return Core::SUCCESS;
+}
+
+// Starts recording a latency histogram for every call of the given proc.
+extern "C" EXPORT const char* latency_track(int n_args, const char** args)
+{
+	if (!Core::initialize() || n_args < 1)
+	{
+		return Core::FAIL;
+	}
+	Core::Proc* proc = Core::try_get_proc(args[0]);
+	if (!proc)
+	{
+		return Core::FAIL;
+	}
+	Profiler::track_proc_latency(proc->id, n_args < 2 || strcmp(args[1], "0"));
+	return Core::SUCCESS;
+}
+
+// Same as latency_track, but for custom opcodes registered through Core::register_opcode.
+extern "C" EXPORT const char* latency_track_opcode(int n_args, const char** args)
+{
+	if (!Core::initialize() || n_args < 1)
+	{
+		return Core::FAIL;
+	}
+	auto ptr = Core::name_to_opcode.find(args[0]);
+	if (ptr == Core::name_to_opcode.end())
+	{
+		return Core::FAIL;
+	}
+	Profiler::track_opcode_latency(ptr->second, n_args < 2 || strcmp(args[1], "0"));
+	return Core::SUCCESS;
+}
+
+// Returns count, mean, p50, p99, p999 and max in microseconds as JSON, or an empty string if the proc is not tracked.
+extern "C" EXPORT const char* latency_percentiles(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize() || n_args < 1)
+	{
+		return "";
+	}
+	Profiler::LatencyTracker* tracker = nullptr;
+	if (Core::Proc* proc = Core::try_get_proc(args[0]))
+	{
+		tracker = Profiler::proc_latency(proc->id);
+	}
+	else if (auto ptr = Core::name_to_opcode.find(args[0]); ptr != Core::name_to_opcode.end())
+	{
+		tracker = Profiler::opcode_latency(ptr->second);
+	}
+	if (!tracker)
+	{
+		return "";
+	}
+	result = Profiler::latency_to_json(*tracker).dump();
+	return result.c_str();
+}
+
+// Sets the reporting interval in seconds. With a non-zero interval, percentiles describe the last complete interval.
+extern "C" EXPORT const char* latency_set_interval(int n_args, const char** args)
+{
+	double seconds = n_args > 0 ? std::atof(args[0]) : 0.0;
+	Profiler::latency_interval = std::chrono::nanoseconds((long long)(seconds * 1e9));
+	Profiler::reset_latency();
+	return Core::SUCCESS;
+}
+
+extern "C" EXPORT const char* latency_reset(int n_args, const char** args)
+{
+	Profiler::reset_latency();
+	return Core::SUCCESS;
+}
+
+// Starts the line sampler. Argument: sampling interval in milliseconds (default 1).
+// Needs the singlestep hook, so this only works on Windows.
+extern "C" EXPORT const char* line_profiler_start(int n_args, const char** args)
+{
+	if (!Core::initialize() || Profiler::line_profiler_running() || !singlestep_acquire())
+	{
+		return Core::FAIL;
+	}
+	double milliseconds = n_args > 0 ? std::atof(args[0]) : 1.0;
+	if (!Profiler::start_line_profiler(std::chrono::microseconds((long long)(milliseconds * 1000))))
+	{
+		singlestep_release();
+		return Core::FAIL;
+	}
+	return Core::SUCCESS;
+}
+
+extern "C" EXPORT const char* line_profiler_stop(int n_args, const char** args)
+{
+	if (Profiler::line_profiler_running())
+	{
+		Profiler::stop_line_profiler();
+		singlestep_release();
+	}
+	return Core::SUCCESS;
+}
+
+extern "C" EXPORT const char* line_profiler_reset(int n_args, const char** args)
+{
+	Profiler::reset_line_profiler();
+	return Core::SUCCESS;
+}
+
+// Arguments: format ("text" or "json"), sort ("exclusive" or "inclusive"), number of lines to return.
+extern "C" EXPORT const char* line_profiler_report(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return "";
+	}
+	bool json = n_args > 0 && !strcmp(args[0], "json");
+	bool by_inclusive = n_args > 1 && !strcmp(args[1], "inclusive");
+	std::size_t count = n_args > 2 ? std::strtoul(args[2], nullptr, 10) : 50;
+	result = json ? Profiler::line_report_json(by_inclusive, count).dump() : Profiler::line_report_text(by_inclusive, count);
+	return result.c_str();
+}
+
+// Counts every executed instruction, globally and per proc. Windows only, like the line profiler.
+extern "C" EXPORT const char* opcode_histogram_start(int n_args, const char** args)
+{
+	if (!Core::initialize() || Profiler::opcode_counting_enabled || !singlestep_acquire())
+	{
+		return Core::FAIL;
+	}
+	Profiler::opcode_counting_enabled = true;
+	return Core::SUCCESS;
+}
+
+// Stops counting and patches the singlestep hook back out if nothing else needs it. Counts are kept.
+extern "C" EXPORT const char* opcode_histogram_stop(int n_args, const char** args)
+{
+	if (Profiler::opcode_counting_enabled)
+	{
+		Profiler::opcode_counting_enabled = false;
+		singlestep_release();
+	}
+	return Core::SUCCESS;
+}
+
+extern "C" EXPORT const char* opcode_histogram_reset(int n_args, const char** args)
+{
+	Profiler::reset_opcode_counts();
+	return Core::SUCCESS;
+}
+
+// Arguments: a proc path to get the counts of a single proc, or the number of busiest procs to include.
+extern "C" EXPORT const char* opcode_histogram_report(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return "";
+	}
+	if (n_args > 0 && args[0][0] == '/')
+	{
+		Core::Proc* proc = Core::try_get_proc(args[0]);
+		if (!proc)
+		{
+			return "";
+		}
+		result = Profiler::proc_opcode_counts_json(proc->id).dump();
+	}
+	else
+	{
+		result = Profiler::opcode_counts_json(n_args > 0 ? std::strtoul(args[0], nullptr, 10) : 10).dump();
+	}
+	return result.c_str();
+}
+
+// Starts tallying the types of src and the arguments of a proc.
+// Arguments: proc path, "1" or "0" to enable or disable, and N to only inspect one in N calls.
+extern "C" EXPORT const char* arg_types_track(int n_args, const char** args)
+{
+	if (!Core::initialize() || n_args < 1)
+	{
+		return Core::FAIL;
+	}
+	Core::Proc* proc = Core::try_get_proc(args[0]);
+	if (!proc)
+	{
+		return Core::FAIL;
+	}
+	std::uint32_t sample_rate = n_args > 2 ? std::strtoul(args[2], nullptr, 10) : 1;
+	Profiler::profile_arg_types(proc->id, n_args < 2 || strcmp(args[1], "0"), sample_rate);
+	return Core::SUCCESS;
+}
+
+// Argument: "calls" to sort by call count, or "monomorphism" to put the most predictable procs first.
+extern "C" EXPORT const char* arg_types_report(int n_args, const char** args)
+{
+	static std::string result;
+	if (!Core::initialize())
+	{
+		return "";
+	}
+	result = Profiler::arg_types_json(n_args > 0 && !strcmp(args[0], "monomorphism")).dump();
+	return result.c_str();
+}
+
+extern "C" EXPORT const char* arg_types_reset(int n_args, const char** args)
+{
+	Profiler::reset_arg_types();
+	return Core::SUCCESS;
+}
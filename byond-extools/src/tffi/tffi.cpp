@@ -3,6 +3,7 @@
 #include "../dmdism/disassembly.h"
 #include "../dmdism/opcodes.h"
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 
@@ -15,6 +16,8 @@ std::uint32_t result_string_id = 0;
 std::uint32_t completed_string_id = 0;
 std::uint32_t internal_id_string_id = 0;
 
+std::atomic<std::uint32_t> in_flight = 0;
+
 std::condition_variable unsuspend_ready_cv;
 std::mutex unsuspend_ready_mutex;
 
@@ -55,6 +58,12 @@ void ffi_thread(byond_ffi_func* proc, int promise_id, int n_args, std::vector<st
 	unsuspend_ready_cv.wait(lk, [internal_id] { return suspended_procs.find(internal_id) != suspended_procs.end();  });
 	suspended_procs.at(internal_id).resume();
 	suspended_procs.erase(internal_id);
+	in_flight--;
+}
+
+std::uint32_t TFFI::calls_in_flight()
+{
+	return in_flight;
 }
 
 inline void do_it(byond_ffi_func* proc, std::string promise_datum_ref, int n_args, const char** args)
@@ -66,6 +75,7 @@ inline void do_it(byond_ffi_func* proc, std::string promise_datum_ref, int n_arg
 	{
 		a.push_back(args[i]);
 	}
+	in_flight++;
 	std::thread t(ffi_thread, proc, promise_id, n_args - 3, a);
 	t.detach();
 }
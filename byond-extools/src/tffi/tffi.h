@@ -12,4 +12,6 @@
 namespace TFFI
 {
 	bool initialize();
+	// Calls started by call_async whose procs haven't been resumed yet.
+	std::uint32_t calls_in_flight();
 }
\ No newline at end of file
@@ -0,0 +1,235 @@
+// Checks build_cfg() on hand-made bytecode and on random procs. Like the decoder, the CFG never touches BYOND,
+// so this runs on the host. The stubs below are only there to link the rest of dmdism.
+
+#include "../src/dmdism/cfg.h"
+#include "../src/dmdism/opcodes_enum.h"
+#include "../src/core/core.h"
+#include "../src/core/proc_management.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+static String stub_string { (char*)"", 0, 0, 0 };
+static String* stub_string_table_entry(int) { return &stub_string; }
+GetStringTableEntryPtr GetStringTableEntry = stub_string_table_entry;
+static std::vector<Core::Proc> stub_procs;
+std::vector<Core::Proc>& Core::get_all_procs() { return stub_procs; }
+std::string Core::GetStringFromId(unsigned int) { return ""; }
+void Core::Alert(const std::string&) {}
+Core::Proc& Core::get_proc(unsigned int) { return stub_procs.at(0); }
+std::map<unsigned int, opcode_handler> Core::opcode_handlers;
+std::map<std::string, unsigned int> Core::name_to_opcode;
+std::uint32_t* Core::Proc::get_bytecode() { return nullptr; }
+std::uint16_t Core::Proc::get_bytecode_length() { return 0; }
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+// OUTPUT takes no operands and falls through, which makes it a convenient filler.
+const std::uint32_t FILL = (std::uint32_t)Bytecode::OUTPUT;
+const std::uint32_t JMP = (std::uint32_t)Bytecode::JMP;
+const std::uint32_t JZ = (std::uint32_t)Bytecode::JZ;
+const std::uint32_t JNZ = (std::uint32_t)Bytecode::JNZ;
+const std::uint32_t RET = (std::uint32_t)Bytecode::RET;
+const std::uint32_t END = (std::uint32_t)Bytecode::END;
+
+static bool build(const std::vector<std::uint32_t>& code, ControlFlowGraph& cfg)
+{
+	DecodedProc decoded;
+	decode(code, decoded);
+	return build_cfg(code, decoded, cfg);
+}
+
+static void test_nested_loops()
+{
+	std::vector<std::uint32_t> code = {
+		FILL, // 0: B0
+		FILL, JZ, 11, // 1: B1, outer loop header, leaves to 11
+		FILL, JNZ, 4, // 4: B2, inner loop on itself
+		JMP, 1, // 7: B3, outer back edge
+		FILL, FILL, // 9: B4, unreachable
+		RET, // 11: B5
+		END, // 12: B6, unreachable
+	};
+	ControlFlowGraph cfg;
+	CHECK(build(code, cfg));
+	CHECK(cfg.blocks.size() == 7);
+	if (cfg.blocks.size() != 7)
+	{
+		return;
+	}
+	CHECK(cfg.blocks[1].begin == 1 && cfg.blocks[1].end == 4 && cfg.blocks[1].count == 2);
+	CHECK((cfg.blocks[1].successors == std::vector<std::uint32_t>{ 5, 2 }));
+	CHECK((cfg.blocks[1].predecessors == std::vector<std::uint32_t>{ 0, 3 }));
+	CHECK(cfg.blocks[2].idom == 1 && cfg.blocks[3].idom == 2 && cfg.blocks[5].idom == 1);
+	CHECK(!cfg.reachable(4) && !cfg.reachable(6));
+	CHECK(cfg.dominates(1, 3) && !cfg.dominates(3, 1) && !cfg.dominates(4, 5));
+	CHECK(cfg.irreducible_edges == 0);
+
+	CHECK(cfg.loops.size() == 2);
+	if (cfg.loops.size() != 2)
+	{
+		return;
+	}
+	const Loop& outer = cfg.loops[0];
+	const Loop& inner = cfg.loops[1];
+	CHECK(outer.header == 1 && outer.depth == 1 && outer.parent == CFG_NONE);
+	CHECK((outer.blocks == std::vector<std::uint32_t>{ 1, 2, 3 }));
+	CHECK((outer.latches == std::vector<std::uint32_t>{ 3 }));
+	CHECK(inner.header == 2 && inner.depth == 2 && inner.parent == 0);
+	CHECK((inner.blocks == std::vector<std::uint32_t>{ 2 }));
+	CHECK((inner.latches == std::vector<std::uint32_t>{ 2 }));
+
+	CHECK(cfg.loop_at(5) == 1);
+	CHECK(cfg.loop_at(7) == 0);
+	CHECK(cfg.loop_at(11) == CFG_NONE);
+	CHECK(cfg.block_at(12) == 6);
+	CHECK(cfg.block_at(13) == CFG_NONE);
+}
+
+static void test_irreducible_loop()
+{
+	// Both 5 and 6 can be entered from the start, so neither dominates the other and there's no natural loop.
+	std::vector<std::uint32_t> code = {
+		JZ, 5, // 0: B0
+		FILL, JMP, 6, // 2: B1
+		FILL, // 5: B2
+		FILL, JNZ, 5, // 6: B3, jumps back into the middle of the cycle
+		RET, // 9: B4
+	};
+	ControlFlowGraph cfg;
+	CHECK(build(code, cfg));
+	CHECK(cfg.blocks.size() == 5);
+	CHECK(cfg.irreducible_edges == 1);
+	CHECK(cfg.loops.empty());
+}
+
+static void test_jump_into_instruction()
+{
+	std::vector<std::uint32_t> code = { JMP, 1, END };
+	ControlFlowGraph cfg;
+	CHECK(!build(code, cfg));
+}
+
+// Random procs of fillers, jumps and returns. Dominance is checked against its definition: a dominates b if b
+// can't be reached from the entry without going through a. Every loop's header has to dominate its blocks.
+static void test_random_procs()
+{
+	std::mt19937 rng(3);
+	for (int round = 0; round < 20000; round++)
+	{
+		std::vector<std::uint32_t> code;
+		std::vector<std::uint32_t> starts;
+		std::vector<std::size_t> jump_operands;
+		int instructions = rng() % 12 + 2;
+		for (int i = 0; i < instructions; i++)
+		{
+			starts.push_back(code.size());
+			switch (rng() % 5)
+			{
+			case 0:
+				code.push_back(JZ);
+				jump_operands.push_back(code.size());
+				code.push_back(0);
+				break;
+			case 1:
+				code.push_back(JMP);
+				jump_operands.push_back(code.size());
+				code.push_back(0);
+				break;
+			case 2:
+				code.push_back(rng() % 3 == 0 ? RET : FILL);
+				break;
+			default:
+				code.push_back(FILL);
+				break;
+			}
+		}
+		starts.push_back(code.size());
+		code.push_back(END);
+		for (std::size_t operand : jump_operands)
+		{
+			code[operand] = starts[rng() % starts.size()];
+		}
+
+		ControlFlowGraph cfg;
+		if (!build(code, cfg))
+		{
+			std::printf("round %d: build_cfg failed on a proc with only valid jumps\n", round);
+			failures++;
+			continue;
+		}
+		std::size_t count = cfg.blocks.size();
+		auto reached_without = [&](std::uint32_t removed) {
+			std::vector<bool> reached(count);
+			if (removed == 0)
+			{
+				return reached;
+			}
+			std::vector<std::uint32_t> pending = { 0 };
+			reached[0] = true;
+			while (!pending.empty())
+			{
+				std::uint32_t block = pending.back();
+				pending.pop_back();
+				for (std::uint32_t successor : cfg.blocks[block].successors)
+				{
+					if (successor != removed && !reached[successor])
+					{
+						reached[successor] = true;
+						pending.push_back(successor);
+					}
+				}
+			}
+			return reached;
+		};
+		std::vector<bool> reachable = reached_without(CFG_NONE);
+		for (std::uint32_t a = 0; a < count; a++)
+		{
+			CHECK(cfg.reachable(a) == reachable[a]);
+			std::vector<bool> reached = reached_without(a);
+			for (std::uint32_t b = 0; b < count; b++)
+			{
+				bool expected = reachable[a] && reachable[b] && (a == b || !reached[b]);
+				if (cfg.dominates(a, b) != expected)
+				{
+					std::printf("round %d: dominates(%u, %u) should be %d\n", round, a, b, expected);
+					failures++;
+				}
+			}
+		}
+		for (const Loop& loop : cfg.loops)
+		{
+			for (std::uint32_t block : loop.blocks)
+			{
+				CHECK(cfg.dominates(loop.header, block));
+			}
+			CHECK(std::find(loop.blocks.begin(), loop.blocks.end(), loop.header) != loop.blocks.end());
+		}
+	}
+}
+
+int main()
+{
+	test_nested_loops();
+	test_irreducible_loop();
+	test_jump_into_instruction();
+	test_random_procs();
+	if (failures)
+	{
+		std::printf("%d checks failed\n", failures);
+		return 1;
+	}
+	std::printf("all checks passed\n");
+	return 0;
+}